@@ -0,0 +1,270 @@
+﻿#include "bigInt.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// --- Benchmark các phép toán của BigIntBinary ---
+// bigint_bench [--bits 512,1024,...] [--ops add,mul,...] [--min-time ms] [--format text|csv|json]
+//              [--kernel scalar|avx2|avx512ifma]
+// Mỗi phép đo lặp (gấp đôi số lần) đến khi đủ --min-time; kết quả là thời gian trung bình ns/op và ops/s.
+
+struct BenchResult {
+    std::string op;
+    int bits;
+    double ns_per_op;
+    long long iterations;
+};
+
+static const char* const ALL_OPS[] = {
+    "add", "sub", "mul", "sqr", "div", "modexp", "to_string", "from_string", "keygen", "validate", "dh", "dh_short"
+};
+
+static volatile limb_t sink; // Giữ kết quả để trình biên dịch không bỏ phép tính
+
+static void consume(const BigIntBinary& x) {
+    sink = sink + (limb_t)x.is_odd() + (limb_t)x.num_bits();
+}
+
+// Số ngẫu nhiên đúng 'bits' bit (bit cao nhất bằng 1), tái lập được nhờ seed cố định
+static BigIntBinary random_number(std::mt19937_64& gen, int bits) {
+    std::vector<uint8_t> bytes((bits + 7) / 8);
+    for (uint8_t& b : bytes) {
+        b = (uint8_t)gen();
+    }
+    int top_bits = bits - 8 * ((int)bytes.size() - 1);
+    bytes[0] &= (uint8_t)((1u << top_bits) - 1);
+    bytes[0] |= (uint8_t)(1u << (top_bits - 1));
+    return BigIntBinary::from_bytes(bytes.data(), bytes.size());
+}
+
+template <typename Op>
+static BenchResult measure(const std::string& name, int bits, double min_time_ms, Op op) {
+    op(); // Làm nóng bộ nhớ đệm và các bảng dựng lười
+    long long reps = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < reps; ++i) {
+            op();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (ns >= min_time_ms * 1e6) {
+            return { name, bits, ns / reps, reps };
+        }
+        reps *= 2;
+    }
+}
+
+static BenchResult run_op(const std::string& op, int bits, double min_time_ms, std::mt19937_64& gen) {
+    BigIntBinary a = random_number(gen, bits);
+    BigIntBinary b = random_number(gen, bits);
+    if (a < b) {
+        std::swap(a, b); // Phép trừ không hỗ trợ kết quả âm
+    }
+
+    if (op == "add") {
+        return measure(op, bits, min_time_ms, [&]() { consume(a + b); });
+    }
+    if (op == "sub") {
+        return measure(op, bits, min_time_ms, [&]() { consume(a - b); });
+    }
+    if (op == "mul") {
+        return measure(op, bits, min_time_ms, [&]() { consume(a * b); });
+    }
+    if (op == "sqr") {
+        return measure(op, bits, min_time_ms, [&]() {
+            BigIntBinary x = a;
+            consume(x.square());
+        });
+    }
+    if (op == "div") {
+        // Số bị chia 2 * bits bit chia cho số chia bits bit
+        BigIntBinary dividend = random_number(gen, 2 * bits);
+        BigIntBinary q, r;
+        return measure(op, bits, min_time_ms, [&]() {
+            dividend.divide(b, q, r);
+            consume(r);
+        });
+    }
+    if (op == "modexp") {
+        BigIntBinary n = b;
+        n.set_bit(0);
+        BigIntBinary base = a % n;
+        return measure(op, bits, min_time_ms, [&]() { consume(modular_exponentiation(base, a, n)); });
+    }
+    if (op == "to_string") {
+        return measure(op, bits, min_time_ms, [&]() {
+            std::ostringstream out;
+            out << a;
+            sink = sink + (limb_t)out.str().size();
+        });
+    }
+    if (op == "from_string") {
+        std::ostringstream out;
+        out << a;
+        std::string s = out.str();
+        return measure(op, bits, min_time_ms, [&]() { consume(BigIntBinary(s)); });
+    }
+    if (op == "keygen") {
+        // Khóa riêng đầy đủ độ dài, byte ngẫu nhiên lấy từ random_source()
+        BigIntBinary p = b;
+        p.set_bit(0);
+        return measure(op, bits, min_time_ms, [&]() { consume(generate_private_key(p)); });
+    }
+    if (op == "validate") {
+        // Kiểm tra khóa công khai (khoảng + ký hiệu Jacobi); chi phí như nhau dù p có nguyên tố hay không
+        BigIntBinary p = b;
+        p.set_bit(0);
+        BigIntBinary y = a % p;
+        return measure(op, bits, min_time_ms, [&]() { sink = sink + (limb_t)validate_public_key(y, p); });
+    }
+    if (op == "dh" || op == "dh_short") {
+        // Một lần bắt tay đầy đủ: hai khóa riêng, hai khóa công khai (bảng của g dựng sẵn), trao đổi dạng byte,
+        // hai bí mật chung. Sinh số nguyên tố an toàn 8192 bit mất quá lâu nên p là số lẻ ngẫu nhiên cùng cỡ:
+        // chi phí các phép lũy thừa không phụ thuộc p có nguyên tố hay không.
+        // dh_short: khóa riêng SHORT_EXPONENT_BITS bit.
+        int exponent_bits = op == "dh_short" ? SHORT_EXPONENT_BITS : 0;
+        BigIntBinary p = b;
+        p.set_bit(0);
+        FixedBaseExp generator(BigIntBinary(2), p);
+        size_t len = p.byte_length();
+        return measure(op, bits, min_time_ms, [&]() {
+            BigIntBinary alice = generate_private_key(p, exponent_bits);
+            BigIntBinary bob = generate_private_key(p, exponent_bits);
+            std::vector<uint8_t> wireA = generator.pow_ct(alice, exponent_bits).to_bytes(len);
+            std::vector<uint8_t> wireB = generator.pow_ct(bob, exponent_bits).to_bytes(len);
+            BigIntBinary A = BigIntBinary::from_bytes(wireA.data(), wireA.size());
+            BigIntBinary B = BigIntBinary::from_bytes(wireB.data(), wireB.size());
+            BigIntBinary s1 = modular_exponentiation_ct(B, alice, p, exponent_bits);
+            BigIntBinary s2 = modular_exponentiation_ct(A, bob, p, exponent_bits);
+            if (!(s1 == s2)) {
+                throw std::runtime_error("Handshake produced different shared secrets");
+            }
+            consume(s1);
+        });
+    }
+    throw std::runtime_error("Unknown operation: " + op);
+}
+
+static std::vector<std::string> split_list(const std::string& s) {
+    std::vector<std::string> items;
+    std::stringstream in(s);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--bits 512,1024,...] [--ops add,sub,mul,sqr,div,modexp,to_string,from_string,keygen,validate,dh,dh_short]\n"
+              << "       [--min-time ms] [--format text|csv|json] [--kernel scalar|avx2|avx512ifma]" << std::endl;
+}
+
+static void print_results(const std::vector<BenchResult>& results, const std::string& format) {
+    const char* kernel = mul_kernel_name(active_mul_kernel());
+    if (format == "csv") {
+        std::cout << "op,bits,ns_per_op,ops_per_sec,iterations,kernel,limb_bits" << std::endl;
+        for (const BenchResult& r : results) {
+            std::cout << r.op << "," << r.bits << "," << std::fixed << std::setprecision(1) << r.ns_per_op << ","
+                      << std::setprecision(1) << 1e9 / r.ns_per_op << "," << r.iterations << ","
+                      << kernel << "," << LIMB_BITS << std::endl;
+        }
+    }
+    else if (format == "json") {
+        std::cout << "{\"kernel\":\"" << kernel << "\",\"limb_bits\":" << LIMB_BITS << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchResult& r = results[i];
+            std::cout << (i ? "," : "") << "\n  {\"op\":\"" << r.op << "\",\"bits\":" << r.bits
+                      << ",\"ns_per_op\":" << std::fixed << std::setprecision(1) << r.ns_per_op
+                      << ",\"ops_per_sec\":" << 1e9 / r.ns_per_op << ",\"iterations\":" << r.iterations << "}";
+        }
+        std::cout << "\n]}" << std::endl;
+    }
+    else {
+        std::cout << "kernel: " << kernel << ", limb: " << LIMB_BITS << " bit" << std::endl;
+        std::cout << std::left << std::setw(12) << "op" << std::right << std::setw(6) << "bits"
+                  << std::setw(16) << "ns/op" << std::setw(16) << "ops/s" << std::setw(12) << "iterations" << std::endl;
+        for (const BenchResult& r : results) {
+            std::cout << std::left << std::setw(12) << r.op << std::right << std::setw(6) << r.bits
+                      << std::fixed << std::setprecision(1) << std::setw(16) << r.ns_per_op
+                      << std::setw(16) << 1e9 / r.ns_per_op << std::setw(12) << r.iterations << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<int> bits = { 512, 1024, 2048, 3072, 4096, 8192 };
+    std::vector<std::string> ops(std::begin(ALL_OPS), std::end(ALL_OPS));
+    double min_time_ms = 100;
+    std::string format = "text";
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (arg == "--bits") {
+                bits.clear();
+                for (const std::string& b : split_list(value)) {
+                    bits.push_back(std::atoi(b.c_str()));
+                    if (bits.back() < 64) {
+                        throw std::runtime_error("Bit size must be at least 64: " + b);
+                    }
+                }
+            }
+            else if (arg == "--ops") {
+                ops = split_list(value);
+                for (const std::string& op : ops) {
+                    if (std::find(std::begin(ALL_OPS), std::end(ALL_OPS), op) == std::end(ALL_OPS)) {
+                        throw std::runtime_error("Unknown operation: " + op);
+                    }
+                }
+            }
+            else if (arg == "--min-time") {
+                min_time_ms = std::atof(value.c_str());
+            }
+            else if (arg == "--format" && (value == "text" || value == "csv" || value == "json")) {
+                format = value;
+            }
+            else if (arg == "--kernel") {
+                MulKernel kernel = value == "scalar" ? MulKernel::Scalar
+                                 : value == "avx2" ? MulKernel::Avx2
+                                 : value == "avx512ifma" ? MulKernel::Avx512Ifma
+                                 : throw std::runtime_error("Unknown kernel: " + value);
+                set_mul_kernel(kernel);
+            }
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+
+        std::mt19937_64 gen(20240601);
+        std::vector<BenchResult> results;
+        for (const std::string& op : ops) {
+            for (int b : bits) {
+                results.push_back(run_op(op, b, min_time_ms, gen));
+            }
+        }
+        print_results(results, format);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,13 +1,58 @@
-﻿/*
-#include "bigInt.h"
-#include <algorithm>
+﻿#include "bigInt.h"
 #include <random>
 #include <stdexcept>
-
-const uint64_t BASE = (1ULL << 32);
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <bcrypt.h>
+#pragma comment(lib, "bcrypt.lib")
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/random.h>
+#endif
+#endif
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(BIGINT_NO_SIMD)
+#define BIGINT_X86_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define BIGINT_TARGET(features)
+#else
+#define BIGINT_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h> // _BitScanReverse
+#endif
+
+using namespace std;
+
+// Giá trị mặc định của các ngưỡng nhân (ý nghĩa xem bigInt.h)
+size_t KARATSUBA_THRESHOLD = LIMB_BITS == 64 ? 32 : 56;
+size_t TOOM3_THRESHOLD = LIMB_BITS == 64 ? 4096 : 224;
+SimdThresholds SIMD_THRESHOLDS[3] = {
+    { 0, 0, 0 }, // Scalar: không dùng
+    LIMB_BITS == 64 ? SimdThresholds{ 44, 144, 144 } : SimdThresholds{ 20, 32, 280 },
+    LIMB_BITS == 64 ? SimdThresholds{ 16, 28, 312 } : SimdThresholds{ 12, 16, 512 },
+};
 
 void BigIntBinary::normalize() {
-    // Xóa các "nhánh" 0 ở cuối vector
+	// Xóa các số 0 thừa ở đầu
     while (!limbs.empty() && limbs.back() == 0) {
         limbs.pop_back();
     }
@@ -16,9 +61,9 @@ void BigIntBinary::normalize() {
 // --- Constructors ---
 BigIntBinary::BigIntBinary(unsigned long long n) {
     limbs.clear();
-    limbs.push_back((uint32_t)(n & 0xFFFFFFFF)); // Lấy 32 bit thấp
-    if (n >> 32) {
-        limbs.push_back((uint32_t)(n >> 32));      // Lấy 32 bit cao
+    limbs.push_back((limb_t)n); // Lấy các bit thấp vừa một limb
+    if (LIMB_BITS == 32 && (n >> 32)) {
+        limbs.push_back((limb_t)(n >> 32));      // Limb 32 bit: lấy 32 bit cao
     }
     normalize();
 }
@@ -27,19 +72,38 @@ BigIntBinary::BigIntBinary(const BigIntBinary& other) {
     limbs = other.limbs;
 }
 
-// --- Phép toán cộng/nhân số nhỏ
+BigIntBinary::BigIntBinary(BigIntBinary&& other) noexcept : limbs(std::move(other.limbs)) {
+}
+
+BigIntBinary& BigIntBinary::operator=(const BigIntBinary& other) {
+    limbs = other.limbs;
+    return *this;
+}
+
+BigIntBinary& BigIntBinary::operator=(BigIntBinary&& other) noexcept {
+    limbs.swap(other.limbs);
+    return *this;
+}
+
+void BigIntBinary::swap(BigIntBinary& other) noexcept {
+    limbs.swap(other.limbs);
+}
+
+// --- Phép toán cộng/nhân số nhỏ ---
 void BigIntBinary::add_int(uint32_t n) {
-    if (n == 0) return;
+    if (n == 0) {
+        return;
+    }
     if (limbs.empty()) limbs.push_back(0);
 
-    uint64_t carry = n;
+    dlimb_t carry = n;
     for (size_t i = 0; i < limbs.size() && carry > 0; ++i) {
-        uint64_t sum = (uint64_t)limbs[i] + carry;
-        limbs[i] = (uint32_t)(sum & 0xFFFFFFFF); 
-        carry = sum >> 32;            
+        dlimb_t sum = (dlimb_t)limbs[i] + carry;
+        limbs[i] = (limb_t)sum;
+        carry = sum >> LIMB_BITS;
     }
     if (carry) {
-        limbs.push_back((uint32_t)carry);
+        limbs.push_back((limb_t)carry);
     }
 }
 
@@ -48,40 +112,53 @@ void BigIntBinary::multiply_by_int(uint32_t n) {
         limbs.clear();
         return;
     }
-    uint64_t carry = 0;
+    dlimb_t carry = 0;
+    for (size_t i = 0; i < limbs.size(); ++i) {
+        dlimb_t product = (dlimb_t)limbs[i] * n + carry;
+        limbs[i] = (limb_t)product;
+        carry = product >> LIMB_BITS;
+    }
+    if (carry) {
+        limbs.push_back((limb_t)carry);
+    }
+}
+
+void BigIntBinary::mul_add_limb(limb_t m, limb_t a) {
+    dlimb_t carry = a;
     for (size_t i = 0; i < limbs.size(); ++i) {
-        uint64_t product = (uint64_t)limbs[i] * n + carry;
-        limbs[i] = (uint32_t)(product & 0xFFFFFFFF);
-        carry = product >> 32;
+        dlimb_t product = (dlimb_t)limbs[i] * m + carry;
+        limbs[i] = (limb_t)product;
+        carry = product >> LIMB_BITS;
     }
     if (carry) {
-        limbs.push_back((uint32_t)carry);
+        limbs.push_back((limb_t)carry);
+    }
+}
+
+limb_t BigIntBinary::divide_by_limb(limb_t d) {
+    dlimb_t remainder = 0;
+    for (size_t i = limbs.size(); i-- > 0;) {
+        dlimb_t current_value = (remainder << LIMB_BITS) | limbs[i];
+        limbs[i] = (limb_t)(current_value / d);
+        remainder = current_value % d;
     }
+    normalize();
+    return (limb_t)remainder;
 }
 
-// --- String Constructor
+// --- String Constructor ---
 BigIntBinary::BigIntBinary(const std::string& s) {
-    limbs.clear(); // Bắt đầu từ 0
     for (char c : s) {
-        if (!isdigit(c)) throw std::runtime_error("Invalid number string");
-        multiply_by_int(10);
-        add_int(c - '0');
+        if (!isdigit(c)) {
+            throw std::runtime_error("Invalid number string");
+        }
     }
+    *this = parse_decimal(s.data(), s.size());
 }
 
 // --- Phép toán quan trọng ---
 void BigIntBinary::divide_by_2() {
-    bool carry = 0;
-    // Dịch bit phải trên từng "nhánh", từ nhánh cao nhất xuống
-    for (int i = limbs.size() - 1; i >= 0; --i) {
-        bool next_carry = (limbs[i] & 1);
-        limbs[i] >>= 1;
-        if (carry) {
-            limbs[i] |= (1U << 31);
-        }
-        carry = next_carry;
-    }
-    normalize();
+    *this >>= 1;
 }
 
 bool BigIntBinary::is_odd() const {
@@ -94,26 +171,7 @@ bool BigIntBinary::is_zero() const {
 }
 
 
-BigIntBinary& BigIntBinary::operator+=(const BigIntBinary& other) {
-    size_t n = limbs.size();
-    size_t m = other.limbs.size();
-
-    if (m > n) limbs.resize(m, 0);
 
-    uint64_t carry = 0;
-    for (size_t i = 0; i < limbs.size(); ++i) {
-        uint64_t sum = (uint64_t)limbs[i] + carry;
-        if (i < m) {
-            sum += other.limbs[i];
-        }
-        limbs[i] = (uint32_t)(sum & 0xFFFFFFFF);
-        carry = sum >> 32;
-    }
-    if (carry) {
-        limbs.push_back((uint32_t)carry);
-    }
-    return *this;
-}
 
 // --- Phép so sánh ---
 bool operator<(const BigIntBinary& a, const BigIntBinary& b) {
@@ -135,17 +193,27 @@ bool operator==(const BigIntBinary& a, const BigIntBinary& b) {
 }
 
 
-uint32_t BigIntBinary::divide_by_10_and_get_remainder() {
-    uint64_t remainder = 0;
+uint32_t BigIntBinary::divide_by_int(uint32_t n) {
+    dlimb_t remainder = 0;
     for (int i = limbs.size() - 1; i >= 0; --i) {
 
-        // Kết hợp số dư từ nhánh trước với nhánh hiện tại
-        uint64_t current_value = (remainder << 32) + limbs[i];
+        dlimb_t current_value = (remainder << LIMB_BITS) + limbs[i];
 
-        limbs[i] = (uint32_t)(current_value / 10);
-        remainder = current_value % 10;
+        limbs[i] = (limb_t)(current_value / n);
+        remainder = current_value % n;
     }
     normalize();
+    return (limb_t)remainder;
+}
+
+uint32_t BigIntBinary::mod_int(uint32_t n) const {
+    // Chia từng nửa 32 bit của limb để chỉ cần phép chia 64 bit
+    uint64_t remainder = 0;
+    for (size_t i = limbs.size(); i-- > 0;) {
+        for (int shift = LIMB_BITS - 32; shift >= 0; shift -= 32) {
+            remainder = ((remainder << 32) | (uint32_t)(limbs[i] >> shift)) % n;
+        }
+    }
     return (uint32_t)remainder;
 }
 
@@ -154,257 +222,3344 @@ std::ostream& operator<<(std::ostream& out, const BigIntBinary& a) {
         return out << "0";
     }
 
-    BigIntBinary temp = a;
-    std::string s = "";
+    // Số chữ số không vượt quá num_bits * log10(2) + 1; ghi đủ rồi bỏ các số 0 ở đầu
+    size_t digits = (size_t)(a.num_bits() * 0.30102999566398120) + 2;
+    std::string s(digits, '0');
+    BigIntBinary::write_decimal(a, &s[0], digits);
+    return out << s.c_str() + s.find_first_not_of('0');
+}
+
+// --- Chuyển đổi thập phân ---
+// Bảng lũy thừa dùng chung giữa các luồng; deque giữ nguyên địa chỉ phần tử khi thêm mới
+const BigIntBinary& BigIntBinary::decimal_power(size_t i) {
+    static std::mutex table_mutex;
+    static std::deque<BigIntBinary> table;
+
+    std::lock_guard<std::mutex> lock(table_mutex);
+    if (table.empty()) {
+        table.push_back(BigIntBinary(DECIMAL_CHUNK));
+    }
+    while (table.size() <= i) {
+        BigIntBinary next;
+        square_into(table.back(), next);
+        table.push_back(std::move(next));
+    }
+    return table[i];
+}
 
-    // Liên tục chia cho 10 để lấy từng chữ số (cơ số 10)
-    while (!temp.is_zero()) {
-        s += (char)(temp.divide_by_10_and_get_remainder() + '0');
+// Xấp xỉ floor(2^(2b) / d), b = số bit của d, sai số vài đơn vị: lặp Newton nhân đôi độ chính xác.
+// Nghịch đảo vh của h bit cao của d (h hơn b/2 một limb bảo vệ để sai số không lớn dần qua các tầng)
+// cho v = vh * 2^(b-h); một bước v' = 2v - floor(v^2 * d / 2^(2b)) chỉ cần bình phương vh cỡ b/2 bit
+// và một tích cỡ b x b, nên tổng các tầng cỡ vài M(b).
+static BigIntBinary approx_reciprocal(const BigIntBinary& d) {
+    const int b = d.num_bits();
+    if (b <= (int)(DECIMAL_DC_THRESHOLD * LIMB_BITS)) {
+        BigIntBinary target, q, r;
+        target.set_bit(2 * b);
+        target.divide(d, q, r);
+        return q;
     }
 
-    std::reverse(s.begin(), s.end());
-    return out << s;
+    const int h = (b + 1) / 2 + LIMB_BITS;
+    const size_t s = (size_t)(b - h);
+    BigIntBinary vh = approx_reciprocal(d >> s);
+    BigIntBinary v2, t;
+    BigIntBinary::square_into(vh, v2);
+    BigIntBinary::multiply_into(v2, d, t);
+    t >>= (size_t)(2 * h);
+    BigIntBinary v = vh << (s + 1);
+    v -= t;
+    return v;
+}
+
+// floor(2^(2b) / d) đúng: sửa xấp xỉ Newton bằng phần dư, v * d <= 2^(2b) < (v + 1) * d
+static BigIntBinary newton_reciprocal(const BigIntBinary& d) {
+    BigIntBinary target;
+    target.set_bit(2 * d.num_bits());
+    BigIntBinary v = approx_reciprocal(d), t;
+    BigIntBinary::multiply_into(v, d, t);
+    while (target < t) {
+        v -= BigIntBinary(1);
+        t -= d;
+    }
+    BigIntBinary rest = target - t;
+    while (!(rest < d)) {
+        v += BigIntBinary(1);
+        rest -= d;
+    }
+    return v;
 }
 
+const BigIntBinary& BigIntBinary::decimal_reciprocal(size_t i) {
+    static std::mutex table_mutex;
+    static std::deque<BigIntBinary> table;
 
-void BigIntBinary::shift_left_1_bit() {
-    bool carry = 0;
-    for (size_t i = 0; i < limbs.size(); ++i) {
-        bool next_carry = (limbs[i] >> 31) & 1;
-        limbs[i] <<= 1;
-        if (carry) limbs[i] |= 1;
-        carry = next_carry;
+    std::lock_guard<std::mutex> lock(table_mutex);
+    while (table.size() <= i) {
+        table.push_back(newton_reciprocal(decimal_power(table.size())));
     }
-    if (carry) limbs.push_back(1);
-    normalize();
+    return table[i];
 }
 
-int BigIntBinary::num_bits() const {
-    if (is_zero()) return 0;
+// Số nhỏ: mỗi phép chia cho 10^DECIMAL_CHUNK_DIGITS cho ra một khối chữ số.
+// Số lớn: x = q * 10^D + r với D = DECIMAL_CHUNK_DIGITS * 2^i nhỏ nhất mà 2D >= digits, nên x < 10^(2D)
+// và thương q < 10^D. Thương tính kiểu Barrett bằng nghịch đảo lưu đệm của 10^D: hai phép nhân
+// cỡ D chữ số thay cho phép chia Knuth D, nên cả phép đổi cơ số chỉ tốn O(M(n) log n).
+void BigIntBinary::write_decimal(const BigIntBinary& x, char* out, size_t digits) {
+    if (x.limbs.size() <= DECIMAL_DC_THRESHOLD) {
+        BigIntBinary t = x;
+        char* p = out + digits;
+        while (!t.is_zero() && p > out) {
+            limb_t chunk = t.divide_by_limb(DECIMAL_CHUNK);
+            for (int j = 0; j < DECIMAL_CHUNK_DIGITS && p > out; ++j) {
+                *--p = (char)('0' + chunk % 10);
+                chunk /= 10;
+            }
+        }
+        std::fill(out, p, '0');
+        return;
+    }
 
-    uint32_t last_limb = limbs.back();
-    int bits_in_last = 32;
+    size_t i = 0;
+    while (((size_t)DECIMAL_CHUNK_DIGITS << (i + 1)) < digits) {
+        i++;
+    }
+    size_t low_digits = (size_t)DECIMAL_CHUNK_DIGITS << i;
+    const BigIntBinary& d = decimal_power(i);
+
+    // x < d^2 < 2^(2b): q = floor(floor(x / 2^(b-1)) * v / 2^(b+1)) nhỏ hơn thương đúng tối đa 2
+    const size_t b = (size_t)d.num_bits();
+    BigIntBinary q, r, t;
+    multiply_into(x >> (b - 1), decimal_reciprocal(i), q);
+    q >>= b + 1;
+    multiply_into(q, d, t);
+    r = x - t;
+    while (!(r < d)) {
+        r -= d;
+        q += BigIntBinary(1);
+    }
+    write_decimal(q, out, digits - low_digits);
+    write_decimal(r, out + digits - low_digits, low_digits);
+}
 
-    for (int i = 31; i >= 0; i--) {
-        if ((last_limb >> i) & 1) {
-            bits_in_last = i + 1;
-            break;
+// Ngược lại: chuỗi ngắn ghép từng khối DECIMAL_CHUNK_DIGITS chữ số bằng một phép nhân-cộng limb;
+// chuỗi dài tách thành phần cao * 10^D + phần thấp, phép nhân dùng Karatsuba/Toom-3.
+BigIntBinary BigIntBinary::parse_decimal(const char* s, size_t len) {
+    BigIntBinary result;
+    if (len <= DECIMAL_DC_THRESHOLD * DECIMAL_CHUNK_DIGITS) {
+        size_t first = len % DECIMAL_CHUNK_DIGITS;
+        if (first == 0) first = DECIMAL_CHUNK_DIGITS;
+        for (size_t pos = 0; pos < len;) {
+            size_t n = pos == 0 ? first : DECIMAL_CHUNK_DIGITS;
+            limb_t chunk = 0, scale = 1;
+            for (size_t j = 0; j < n; ++j) {
+                chunk = chunk * 10 + (limb_t)(s[pos + j] - '0');
+                scale *= 10;
+            }
+            if (pos == 0) {
+                if (chunk != 0) result.limbs.push_back(chunk);
+            }
+            else {
+                result.mul_add_limb(scale, chunk);
+            }
+            pos += n;
         }
+        result.normalize();
+        return result;
+    }
+
+    size_t i = 0;
+    while (((size_t)DECIMAL_CHUNK_DIGITS << (i + 1)) < len) {
+        i++;
     }
+    size_t low_digits = (size_t)DECIMAL_CHUNK_DIGITS << i;
 
-    return (limbs.size() - 1) * 32 + bits_in_last;
+    multiply_into(parse_decimal(s, len - low_digits), decimal_power(i), result);
+    result += parse_decimal(s + len - low_digits, low_digits);
+    return result;
 }
 
-bool BigIntBinary::get_bit(int n) const {
-    int limb_index = n / 32;
-    int bit_index = n % 32;
-    if (limb_index >= limbs.size()) return 0;
-    return (limbs[limb_index] >> bit_index) & 1;
+// --- Nhị phân và hex ---
+BigIntBinary BigIntBinary::from_bytes(const uint8_t* data, size_t len) {
+    const size_t limb_bytes = LIMB_BITS / 8;
+    BigIntBinary x;
+    x.limbs.resize((len + limb_bytes - 1) / limb_bytes);
+    // Byte cuối là byte thấp nhất
+    for (size_t i = 0; i < len; ++i) {
+        x.limbs[i / limb_bytes] |= (limb_t)data[len - 1 - i] << (8 * (i % limb_bytes));
+    }
+    x.normalize();
+    return x;
 }
 
-void BigIntBinary::set_bit(int n) {
-    int limb_index = n / 32;
-    int bit_index = n % 32;
+size_t BigIntBinary::byte_length() const {
+    return (num_bits() + 7) / 8;
+}
 
-    if (limb_index >= limbs.size()) {
-        limbs.resize(limb_index + 1, 0);
+void BigIntBinary::to_bytes(uint8_t* out, size_t len) const {
+    if (byte_length() > len) {
+        throw std::runtime_error("Output buffer too small for value");
+    }
+    const size_t limb_bytes = LIMB_BITS / 8;
+    for (size_t i = 0; i < len; ++i) {
+        size_t index = i / limb_bytes;
+        out[len - 1 - i] = index < limbs.size() ? (uint8_t)(limbs[index] >> (8 * (i % limb_bytes))) : 0;
     }
-    limbs[limb_index] |= (1U << bit_index);
 }
 
+std::vector<uint8_t> BigIntBinary::to_bytes(size_t len) const {
+    std::vector<uint8_t> out(len == 0 ? byte_length() : len);
+    to_bytes(out.data(), out.size());
+    return out;
+}
 
-// --- Phép trừ ---
-BigIntBinary& BigIntBinary::operator-=(const BigIntBinary& other) {
-    if (*this < other) {
-        throw std::runtime_error("Subtraction underflow (negative result not supported)");
+BigIntBinary BigIntBinary::from_hex(const std::string& s) {
+    const size_t limb_nibbles = LIMB_BITS / 4;
+    BigIntBinary x;
+    x.limbs.resize((s.size() + limb_nibbles - 1) / limb_nibbles);
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[s.size() - 1 - i];
+        limb_t v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else throw std::runtime_error("Invalid hex string");
+        x.limbs[i / limb_nibbles] |= v << (4 * (i % limb_nibbles));
     }
+    x.normalize();
+    return x;
+}
 
-    int64_t borrow = 0;
-    size_t n = limbs.size();
-    size_t m = other.limbs.size();
+std::string BigIntBinary::to_hex() const {
+    if (is_zero()) {
+        return "0";
+    }
+    static const char digits[] = "0123456789abcdef";
+    const size_t limb_nibbles = LIMB_BITS / 4;
+    size_t nibbles = (num_bits() + 3) / 4;
+    std::string s(nibbles, '0');
+    for (size_t i = 0; i < nibbles; ++i) {
+        s[nibbles - 1 - i] = digits[(limbs[i / limb_nibbles] >> (4 * (i % limb_nibbles))) & 0xF];
+    }
+    return s;
+}
 
-    for (size_t i = 0; i < n; ++i) {
-        int64_t diff = (int64_t)limbs[i] - borrow - (i < m ? other.limbs[i] : 0);
+// --- Các thao tác bit ---
+// Số bit 0 ở đầu của x (x != 0)
+static inline int count_leading_zeros(limb_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return LIMB_BITS == 64 ? __builtin_clzll((unsigned long long)x) : __builtin_clz((unsigned int)x);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, (unsigned long)x); // MSVC luôn dùng limb 32 bit
+    return LIMB_BITS - 1 - (int)index;
+#else
+    int n = 0;
+    while (!(x & LIMB_HIGH_BIT)) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
 
-        if (diff < 0) {
-            limbs[i] = (uint32_t)(diff + BASE);
-            borrow = 1;
-        }
-        else {
-            limbs[i] = (uint32_t)diff;
-            borrow = 0;
+BigIntBinary& BigIntBinary::operator<<=(size_t shift) {
+    if (is_zero() || shift == 0) return *this;
+    size_t limb_shift = shift / LIMB_BITS;
+    int bit_shift = (int)(shift % LIMB_BITS);
+    size_t n = limbs.size();
+    limbs.resize(n + limb_shift + 1, 0);
+    limb_t* p = limbs.data();
+    if (bit_shift == 0) {
+        std::memmove(p + limb_shift, p, n * sizeof(limb_t));
+    }
+    else {
+        // Từ limb cao xuống để không ghi đè limb nguồn chưa đọc
+        p[n + limb_shift] = p[n - 1] >> (LIMB_BITS - bit_shift);
+        for (size_t i = n - 1; i > 0; --i) {
+            p[i + limb_shift] = (p[i] << bit_shift) | (p[i - 1] >> (LIMB_BITS - bit_shift));
         }
+        p[limb_shift] = p[0] << bit_shift;
     }
+    std::fill(p, p + limb_shift, 0);
     normalize();
     return *this;
 }
 
-// --- Phép nhân ---
-BigIntBinary& BigIntBinary::operator*=(const BigIntBinary& other) {
-    BigIntBinary result;
-    size_t n = limbs.size();
-    size_t m = other.limbs.size();
-    if (n == 0 || m == 0) { *this = result; return *this; }
-
-    result.limbs.resize(n + m, 0);
-
-    for (size_t i = 0; i < n; ++i) {
-        uint64_t carry = 0;
-        for (size_t j = 0; j < m; ++j) {
-
-            uint64_t product = (uint64_t)limbs[i] * other.limbs[j]
-                + result.limbs[i + j] + carry;
-
-            result.limbs[i + j] = (uint32_t)(product & 0xFFFFFFFF);
-            carry = product >> 32;
+BigIntBinary& BigIntBinary::operator>>=(size_t shift) {
+    size_t limb_shift = shift / LIMB_BITS;
+    int bit_shift = (int)(shift % LIMB_BITS);
+    if (limb_shift >= limbs.size()) {
+        limbs.clear();
+        return *this;
+    }
+    size_t n = limbs.size() - limb_shift;
+    limb_t* p = limbs.data();
+    if (bit_shift == 0) {
+        std::memmove(p, p + limb_shift, n * sizeof(limb_t));
+    }
+    else {
+        for (size_t i = 0; i + 1 < n; ++i) {
+            p[i] = (p[i + limb_shift] >> bit_shift) | (p[i + limb_shift + 1] << (LIMB_BITS - bit_shift));
         }
-        result.limbs[i + m] += (uint32_t)carry;
+        p[n - 1] = p[n - 1 + limb_shift] >> bit_shift;
     }
-
-    result.normalize();
-    *this = result;
+    limbs.resize(n);
+    normalize();
     return *this;
 }
 
-// --- Phép chia & Modulo  ---
-void BigIntBinary::divide(const BigIntBinary& divisor, BigIntBinary& quotient, BigIntBinary& remainder) const {
-    if (divisor.is_zero()) {
-        throw std::runtime_error("Division by zero");
-    }
-
-    quotient = BigIntBinary(0);
-    remainder = BigIntBinary(0);
-    int bits = this->num_bits();
-
-    for (int i = bits - 1; i >= 0; i--) {
-        // 1. Dịch trái số dư (remainder = remainder * 2)
-        remainder.shift_left_1_bit();
+BigIntBinary operator<<(const BigIntBinary& a, size_t shift) {
+    BigIntBinary temp = a;
+    temp <<= shift;
+    return temp;
+}
 
-        // 2. "Hạ" bit tiếp theo của số bị chia vào
-        if (this->get_bit(i)) {
-            remainder.set_bit(0); // Đặt bit thấp nhất là 1
-        }
+BigIntBinary operator>>(const BigIntBinary& a, size_t shift) {
+    BigIntBinary temp = a;
+    temp >>= shift;
+    return temp;
+}
 
-        // 3. So sánh và trừ
-        if (remainder >= divisor) {
-            remainder -= divisor;
-            quotient.set_bit(i); // Đặt bit tương ứng trong thương
-        }
+BigIntBinary& BigIntBinary::operator&=(const BigIntBinary& other) {
+    size_t n = std::min(limbs.size(), other.limbs.size());
+    limbs.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        limbs[i] &= other.limbs[i];
     }
+    normalize();
+    return *this;
 }
 
-BigIntBinary& BigIntBinary::operator/=(const BigIntBinary& other) {
-    BigIntBinary quotient, remainder;
-    this->divide(other, quotient, remainder);
-    *this = quotient;
+BigIntBinary& BigIntBinary::operator|=(const BigIntBinary& other) {
+    if (other.limbs.size() > limbs.size()) {
+        limbs.resize(other.limbs.size(), 0);
+    }
+    for (size_t i = 0; i < other.limbs.size(); ++i) {
+        limbs[i] |= other.limbs[i];
+    }
     return *this;
 }
 
-BigIntBinary& BigIntBinary::operator%=(const BigIntBinary& other) {
-    BigIntBinary quotient, remainder;
-    this->divide(other, quotient, remainder);
-    *this = remainder;
+BigIntBinary& BigIntBinary::operator^=(const BigIntBinary& other) {
+    if (other.limbs.size() > limbs.size()) {
+        limbs.resize(other.limbs.size(), 0);
+    }
+    for (size_t i = 0; i < other.limbs.size(); ++i) {
+        limbs[i] ^= other.limbs[i];
+    }
+    normalize();
     return *this;
 }
 
-// --- Các toán tử tiện ích ---
-BigIntBinary operator+(const BigIntBinary& a, const BigIntBinary& b) {
-    BigIntBinary temp = a; temp += b; return temp;
-}
-BigIntBinary operator-(const BigIntBinary& a, const BigIntBinary& b) {
-    BigIntBinary temp = a; temp -= b; return temp;
-}
-BigIntBinary operator*(const BigIntBinary& a, const BigIntBinary& b) {
-    BigIntBinary temp = a; temp *= b; return temp;
+BigIntBinary operator&(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary temp = a;
+    temp &= b;
+    return temp;
 }
-BigIntBinary operator/(const BigIntBinary& a, const BigIntBinary& b) {
-    BigIntBinary temp = a; temp /= b; return temp;
+
+BigIntBinary operator|(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary temp = a;
+    temp |= b;
+    return temp;
 }
-BigIntBinary operator%(const BigIntBinary& a, const BigIntBinary& b) {
-    BigIntBinary temp = a; temp %= b; return temp;
+
+BigIntBinary operator^(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary temp = a;
+    temp ^= b;
+    return temp;
 }
 
-bool operator!=(const BigIntBinary& a, const BigIntBinary& b) {
-    return !(a == b);
+void BigIntBinary::shift_left_1_bit() {
+    *this <<= 1;
 }
-bool operator>(const BigIntBinary& a, const BigIntBinary& b) {
-    return b < a;
+
+int BigIntBinary::num_bits() const {
+    if (is_zero()) return 0;
+    return (int)(limbs.size() * LIMB_BITS) - count_leading_zeros(limbs.back());
 }
-bool operator<=(const BigIntBinary& a, const BigIntBinary& b) {
-    return !(b < a);
+
+bool BigIntBinary::get_bit(int n) const {
+    int limb_index = n / LIMB_BITS;
+    int bit_index = n % LIMB_BITS;
+    if (limb_index >= limbs.size()) return 0;
+    return (limbs[limb_index] >> bit_index) & 1;
 }
-bool operator>=(const BigIntBinary& a, const BigIntBinary& b) {
-    return !(a < b);
+
+uint64_t BigIntBinary::get_bits(int pos, int count) const {
+    uint64_t v = 0;
+    int done = 0;
+    while (done < count) {
+        size_t limb_index = (size_t)(pos + done) / LIMB_BITS;
+        int bit_index = (pos + done) % LIMB_BITS;
+        if (limb_index >= limbs.size()) break;
+        v |= (uint64_t)(limbs[limb_index] >> bit_index) << done;
+        done += LIMB_BITS - bit_index;
+    }
+    return count < 64 ? v & (((uint64_t)1 << count) - 1) : v;
 }
 
+void BigIntBinary::set_bit(int n) {
+    int limb_index = n / LIMB_BITS;
+    int bit_index = n % LIMB_BITS;
 
-BigIntBinary modular_exponentiation(BigIntBinary a, BigIntBinary b, BigIntBinary n) {
-    BigIntBinary res(1);
-    a = a % n;
-    while (!b.is_zero()) {
-        if (b.is_odd()) res = (res * a) % n;
-        a = (a * a) % n;
-        b.divide_by_2();
+    if (limb_index >= limbs.size()) {
+        limbs.resize(limb_index + 1, 0);
     }
-    return res;
+    limbs[limb_index] |= ((limb_t)1 << bit_index);
 }
 
-BigIntBinary generate_private_key(const BigIntBinary& p) {
 
-    static std::random_device rd;
-    static std::mt19937_64 gen(rd());
+// --- Các phép toán ---
+BigIntBinary& BigIntBinary::operator+=(const BigIntBinary& other) {
+    size_t n = limbs.size();
+    size_t m = other.limbs.size();
 
-    std::uniform_int_distribution<uint32_t> dis_32(0, 0xFFFFFFFF);
+    if (m > n) {
+        limbs.resize(m, 0);
+    }
 
+    dlimb_t carry = 0;
+    for (size_t i = 0; i < limbs.size(); ++i) {
+        dlimb_t sum = (dlimb_t)limbs[i] + carry;
+        if (i < m) {
+            sum += other.limbs[i];
+        }
+        limbs[i] = (limb_t)sum;
+        carry = sum >> LIMB_BITS;
+    }
+    if (carry) {
+        limbs.push_back((limb_t)carry);
+    }
+    return *this;
+}
 
-    BigIntBinary min(2);
-    BigIntBinary max = p - min;
+BigIntBinary& BigIntBinary::operator-=(const BigIntBinary& other) {
+    if (*this < other) {
+        throw std::runtime_error("Subtraction underflow (negative result not supported)");
+    }
 
-    // Lấy số bit tối đa của khóa
-    int max_bits = max.num_bits();
+    limb_t borrow = 0;
+    size_t n = limbs.size();
+    size_t m = other.limbs.size();
 
-    // Xử lý trường hợp p quá nhỏ (ví dụ p=3, phạm vi [2, 1] là không hợp lệ)
-    if (max_bits < 2) {
-        throw std::runtime_error("So nguyen to p qua nho de tao khoa rieng.");
+    for (size_t i = 0; i < n; ++i) {
+        limb_t sub = (i < m ? other.limbs[i] : 0);
+        // Mượn 1 từ limb kế tiếp khi limbs[i] < sub + borrow
+        limb_t next_borrow = (limbs[i] < sub) || (limbs[i] - sub < borrow);
+        limbs[i] = limbs[i] - sub - borrow;
+        borrow = next_borrow;
     }
+    normalize();
+    return *this;
+}
 
-    BigIntBinary k;
 
-    do {
-        k = BigIntBinary(0); // Reset khóa k về 0
+BigIntBinary& BigIntBinary::operator*=(const BigIntBinary& other) {
+    BigIntBinary result;
+    multiply_into(*this, other, result);
+    swap(result);
+    return *this;
+}
 
-        uint32_t current_random_limb = 0;
-        int bits_in_limb = 0;
+BigIntBinary& BigIntBinary::square() {
+    BigIntBinary result;
+    square_into(*this, result);
+    swap(result);
+    return *this;
+}
 
-        // Tạo một số ngẫu nhiên k có 'max_bits' bit
-        for (int i = 0; i < max_bits; ++i) {
+// --- Nhân SIMD ---
+// Kernel nhân theo cột (product scanning): cột k = sum a_i * b_(k-i), mỗi vector giữ nhiều cột liền nhau nên
+// không có chuỗi carry trong vòng lặp trong; carry được truyền một lần khi ghép các cột về limb.
+// AVX2: chữ số 26 bit, _mm256_mul_epu32 cho tích < 2^52. AVX-512 IFMA: chữ số 52 bit, madd52lo/hi cộng
+// nửa thấp vào cột k và nửa cao vào cột k + 1. Với toán hạng nhỏ hơn tối đa SIMD_MAX_DIGITS chữ số,
+// mỗi cột < 2^63 nên không tràn.
+const size_t SIMD_MAX_DIGITS = 1024;
+const size_t SIMD_PAD = 16; // Số 0 đệm hai đầu b để các lần nạp không lệch ra ngoài
+
+// Tách a (n limb) thành 'count' chữ số 'bits' bit
+static void split_digits(const limb_t* a, size_t n, int bits, uint64_t* out, size_t count) {
+    const uint64_t mask = ((uint64_t)1 << bits) - 1;
+    for (size_t d = 0; d < count; ++d) {
+        size_t pos = d * bits;
+        size_t w = pos / LIMB_BITS;
+        int shift = (int)(pos % LIMB_BITS);
+        uint64_t v = w < n ? (uint64_t)(a[w] >> shift) : 0;
+        for (int got = LIMB_BITS - shift; got < bits && ++w < n; got += LIMB_BITS) {
+            v |= (uint64_t)a[w] << got;
+        }
+        out[d] = v & mask;
+    }
+}
 
-            // Nếu đã dùng hết bit trong "nhánh" 32-bit, tạo nhánh mới
-            if (bits_in_limb == 0) {
-                current_random_limb = dis_32(gen);
-                bits_in_limb = 32;
-            }
+// r (rn limb) = sum col[k] * 2^(bits * k), truyền carry giữa các cột
+static void join_digits(const uint64_t* col, size_t count, int bits, limb_t* r, size_t rn) {
+    const uint64_t mask = ((uint64_t)1 << bits) - 1;
+    uint64_t carry = 0, word = 0;
+    int have = 0;
+    size_t w = 0;
+    auto emit = [&](uint64_t x) {
+        for (int s = 0; s < 64 && w < rn; s += LIMB_BITS) {
+            r[w++] = (limb_t)(x >> s);
+        }
+    };
+    for (size_t k = 0; k < count || carry != 0; ++k) {
+        uint64_t v = (k < count ? col[k] : 0) + carry;
+        uint64_t digit = v & mask;
+        carry = v >> bits;
+        word |= digit << have;
+        if (have + bits >= 64) {
+            emit(word);
+            word = digit >> (64 - have); // have > 0 vì bits < 64
+            have += bits - 64;
+        }
+        else {
+            have += bits;
+        }
+    }
+    emit(word);
+    while (w < rn) {
+        r[w++] = 0;
+    }
+}
 
-            // Lấy 1 bit ngẫu nhiên (bit cuối của 'current_random_limb')
-            if (current_random_limb & 1) {
-                k.set_bit(i); // Bật bit thứ 'i' của k lên
-            }
+#ifdef BIGINT_X86_SIMD
+BIGINT_TARGET("avx2")
+static void mul_columns_avx2(uint64_t* col, const uint64_t* a, size_t na, const uint64_t* b_padded, size_t nb) {
+    size_t nc = na + nb - 1;
+    for (size_t c = 0; c < nc; c += 16) {
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        size_t i_min = c >= nb ? c - nb + 1 : 0;
+        size_t i_max = std::min(na - 1, c + 15);
+        for (size_t i = i_min; i <= i_max; ++i) {
+            __m256i ai = _mm256_set1_epi64x((long long)a[i]);
+            const uint64_t* p = b_padded + SIMD_PAD + c - i; // p[t] = b_(c + t - i)
+            acc0 = _mm256_add_epi64(acc0, _mm256_mul_epu32(ai, _mm256_loadu_si256((const __m256i*)p)));
+            acc1 = _mm256_add_epi64(acc1, _mm256_mul_epu32(ai, _mm256_loadu_si256((const __m256i*)(p + 4))));
+            acc2 = _mm256_add_epi64(acc2, _mm256_mul_epu32(ai, _mm256_loadu_si256((const __m256i*)(p + 8))));
+            acc3 = _mm256_add_epi64(acc3, _mm256_mul_epu32(ai, _mm256_loadu_si256((const __m256i*)(p + 12))));
+        }
+        _mm256_storeu_si256((__m256i*)(col + c), acc0);
+        _mm256_storeu_si256((__m256i*)(col + c + 4), acc1);
+        _mm256_storeu_si256((__m256i*)(col + c + 8), acc2);
+        _mm256_storeu_si256((__m256i*)(col + c + 12), acc3);
+    }
+}
 
-            // Chuyển sang bit tiếp theo
-            current_random_limb >>= 1;
-            bits_in_limb--;
+BIGINT_TARGET("avx512f,avx512ifma")
+static void mul_columns_ifma(uint64_t* col, const uint64_t* a, size_t na, const uint64_t* b_padded, size_t nb) {
+    size_t nc = na + nb;
+    for (size_t c = 0; c < nc; c += 16) {
+        __m512i lo0 = _mm512_setzero_si512(), lo1 = lo0, hi0 = lo0, hi1 = lo0;
+        size_t i_min = c >= nb ? c - nb : 0;
+        size_t i_max = std::min(na - 1, c + 15);
+        for (size_t i = i_min; i <= i_max; ++i) {
+            __m512i ai = _mm512_set1_epi64((long long)a[i]);
+            const uint64_t* p = b_padded + SIMD_PAD + c - i;
+            lo0 = _mm512_madd52lo_epu64(lo0, ai, _mm512_loadu_si512(p));
+            lo1 = _mm512_madd52lo_epu64(lo1, ai, _mm512_loadu_si512(p + 8));
+            hi0 = _mm512_madd52hi_epu64(hi0, ai, _mm512_loadu_si512(p - 1));
+            hi1 = _mm512_madd52hi_epu64(hi1, ai, _mm512_loadu_si512(p + 7));
         }
+        _mm512_storeu_si512(col + c, _mm512_add_epi64(lo0, hi0));
+        _mm512_storeu_si512(col + c + 8, _mm512_add_epi64(lo1, hi1));
+    }
+}
 
-        // Lặp lại nếu k nằm ngoài phạm vi [min, max]
-    } while (k < min || k > max);
+static bool cpu_supports(MulKernel kernel) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27))) return false; // OSXSAVE
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+    bool ifma = (info[1] & (1 << 16)) && (info[1] & (1 << 21)) && (xcr0 & 0xE6) == 0xE6;
+#else
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+    bool ifma = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+#endif
+    switch (kernel) {
+    case MulKernel::Scalar: return true;
+    case MulKernel::Avx2: return avx2;
+    case MulKernel::Avx512Ifma: return ifma;
+    }
+    return false;
+}
+#else
+static bool cpu_supports(MulKernel kernel) {
+    return kernel == MulKernel::Scalar;
+}
+#endif
 
-    // Trả về khóa hợp lệ
-    return k;
+bool mul_kernel_supported(MulKernel kernel) {
+    static const bool supported[3] = {
+        true, cpu_supports(MulKernel::Avx2), cpu_supports(MulKernel::Avx512Ifma)
+    };
+    return supported[(int)kernel];
 }
 
+MulKernel detect_mul_kernel() {
+    if (mul_kernel_supported(MulKernel::Avx512Ifma)) return MulKernel::Avx512Ifma;
+    // Với limb 64 bit, chữ số 26 bit của AVX2 không nhanh hơn tích 128 bit vô hướng ở các cỡ khóa thông dụng
+    if (LIMB_BITS == 32 && mul_kernel_supported(MulKernel::Avx2)) return MulKernel::Avx2;
+    return MulKernel::Scalar;
+}
 
-BigIntBinary& BigIntBinary::operator=(const BigIntBinary& other) {
-    limbs = other.limbs;
-    return *this;
+static MulKernel& current_mul_kernel() {
+    static MulKernel kernel = detect_mul_kernel();
+    return kernel;
+}
+
+MulKernel active_mul_kernel() {
+    return current_mul_kernel();
+}
+
+void set_mul_kernel(MulKernel kernel) {
+    if (!mul_kernel_supported(kernel)) {
+        throw std::runtime_error(std::string("Multiplication kernel not supported by this CPU: ") + mul_kernel_name(kernel));
+    }
+    current_mul_kernel() = kernel;
+}
+
+const char* mul_kernel_name(MulKernel kernel) {
+    switch (kernel) {
+    case MulKernel::Scalar: return "scalar";
+    case MulKernel::Avx2: return "avx2";
+    case MulKernel::Avx512Ifma: return "avx512ifma";
+    }
+    return "?";
+}
+
+// r = a * b bằng kernel SIMD (n >= m); trả về false nếu kernel là bản vô hướng hoặc toán hạng quá lớn
+static bool mul_simd_limbs(MulKernel kernel, limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m) {
+#ifdef BIGINT_X86_SIMD
+    if (kernel == MulKernel::Scalar) return false;
+    int bits = kernel == MulKernel::Avx2 ? 26 : 52;
+    size_t na = (n * LIMB_BITS + bits - 1) / bits;
+    size_t nb = (m * LIMB_BITS + bits - 1) / bits;
+    if (nb > SIMD_MAX_DIGITS) return false;
+
+    // Vùng nhớ riêng cho mỗi luồng: a, b có đệm, các cột (làm tròn lên bội 16)
+    size_t nc = (na + nb + 15) / 16 * 16;
+    thread_local std::vector<uint64_t> buffer;
+    size_t need = na + (nb + 2 * SIMD_PAD) + nc;
+    if (buffer.size() < need) {
+        buffer.resize(need);
+    }
+    uint64_t* da = buffer.data();
+    uint64_t* db = da + na;
+    uint64_t* col = db + nb + 2 * SIMD_PAD;
+    split_digits(a, n, bits, da, na);
+    std::fill(db, db + SIMD_PAD, 0);
+    split_digits(b, m, bits, db + SIMD_PAD, nb);
+    std::fill(db + SIMD_PAD + nb, db + nb + 2 * SIMD_PAD, 0);
+
+    if (kernel == MulKernel::Avx2) {
+        mul_columns_avx2(col, da, na, db, nb);
+        join_digits(col, na + nb - 1, bits, r, n + m);
+    }
+    else {
+        mul_columns_ifma(col, da, na, db, nb);
+        join_digits(col, na + nb, bits, r, n + m);
+    }
+    return true;
+#else
+    (void)kernel; (void)r; (void)a; (void)n; (void)b; (void)m;
+    return false;
+#endif
+}
+
+void BigIntBinary::mul_basecase_limbs(limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m) {
+    if (n < m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+    MulKernel kernel = current_mul_kernel();
+    if (m >= SIMD_THRESHOLDS[(int)kernel].mul && mul_simd_limbs(kernel, r, a, n, b, m)) return;
+    mul_schoolbook_limbs(r, a, n, b, m);
+}
+
+void BigIntBinary::sqr_basecase_limbs(limb_t* r, const limb_t* a, size_t n) {
+    MulKernel kernel = current_mul_kernel();
+    if (n >= SIMD_THRESHOLDS[(int)kernel].sqr && mul_simd_limbs(kernel, r, a, n, a, n)) return;
+    sqr_schoolbook_limbs(r, a, n);
+}
+
+// Ngưỡng Karatsuba cho trường hợp cơ sở đang dùng
+static size_t karatsuba_threshold() {
+    MulKernel kernel = current_mul_kernel();
+    size_t t = kernel == MulKernel::Scalar ? KARATSUBA_THRESHOLD : SIMD_THRESHOLDS[(int)kernel].karatsuba;
+    return std::max<size_t>(t, 4);
+}
+
+// Toom-3 chỉ có lợi khi các tích con (khoảng n / 3 limb) đã ở vùng Karatsuba
+static size_t toom3_threshold() {
+    size_t k = karatsuba_threshold();
+    return std::max(TOOM3_THRESHOLD, k > SIZE_MAX / 3 ? SIZE_MAX : 3 * k);
+}
+
+// --- Nhân nhanh ---
+BigIntBinary BigIntBinary::slice(size_t from, size_t to) const {
+    BigIntBinary result;
+    if (from < limbs.size()) {
+        to = std::min(to, limbs.size());
+        result.limbs.assign(limbs.begin() + from, limbs.begin() + to);
+        result.normalize();
+    }
+    return result;
+}
+
+void BigIntBinary::add_shifted(const BigIntBinary& x, size_t offset) {
+    size_t m = x.limbs.size();
+    if (m == 0) return;
+    if (limbs.size() < offset + m) {
+        limbs.resize(offset + m, 0);
+    }
+
+    limb_t carry = add_limbs(limbs.data() + offset, limbs.size() - offset, x.limbs.data(), m);
+    if (carry) {
+        limbs.push_back(carry);
+    }
+}
+
+limb_t BigIntBinary::add_limbs(limb_t* r, size_t rn, const limb_t* x, size_t xn) {
+    dlimb_t carry = 0;
+    size_t i = 0;
+    for (; i < xn; ++i) {
+        dlimb_t sum = (dlimb_t)r[i] + x[i] + carry;
+        r[i] = (limb_t)sum;
+        carry = sum >> LIMB_BITS;
+    }
+    for (; carry > 0 && i < rn; ++i) {
+        dlimb_t sum = (dlimb_t)r[i] + carry;
+        r[i] = (limb_t)sum;
+        carry = sum >> LIMB_BITS;
+    }
+    return (limb_t)carry;
+}
+
+limb_t BigIntBinary::sub_limbs(limb_t* r, size_t rn, const limb_t* x, size_t xn) {
+    limb_t borrow = 0;
+    size_t i = 0;
+    for (; i < xn; ++i) {
+        dlimb_t diff = (dlimb_t)r[i] - x[i] - borrow;
+        r[i] = (limb_t)diff;
+        borrow = (limb_t)(diff >> (2 * LIMB_BITS - 1));
+    }
+    for (; borrow > 0 && i < rn; ++i) {
+        borrow = r[i] == 0 ? 1 : 0;
+        r[i]--;
+    }
+    return borrow;
+}
+
+void BigIntBinary::mul_schoolbook_limbs(limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m) {
+    std::fill(r, r + n + m, 0);
+
+    for (size_t i = 0; i < n; ++i) {
+        dlimb_t carry = 0;
+        for (size_t j = 0; j < m; ++j) {
+
+            dlimb_t product = (dlimb_t)a[i] * b[j] + r[i + j] + carry;
+
+            r[i + j] = (limb_t)product;
+            carry = product >> LIMB_BITS;
+        }
+        r[i + m] = (limb_t)carry;
+    }
+}
+
+// Karatsuba: 3 phép nhân nửa kích thước thay cho 4 (yêu cầu n >= m > n / 2)
+// a = a1 * B^l + a0, b = b1 * B^l + b0
+// a * b = z2 * B^2l + ((a0 + a1)(b0 + b1) - z0 - z2) * B^l + z0
+void BigIntBinary::mul_karatsuba_limbs(limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m, limb_t* scratch) {
+    size_t l = n / 2;
+    size_t hi = n - l;
+
+    // z0 vào r[0, 2l), z2 vào r[2l, n + m)
+    mul_limbs(r, a, l, b, l, scratch);
+    mul_limbs(r + 2 * l, a + l, hi, b + l, m - l, scratch);
+
+    // sa = a0 + a1, sb = b0 + b1
+    limb_t* sa = scratch;
+    std::copy(a + l, a + n, sa);
+    sa[hi] = add_limbs(sa, hi, a, l);
+
+    const limb_t* b_long = (m - l >= l) ? b + l : b;
+    const limb_t* b_short = (m - l >= l) ? b : b + l;
+    size_t long_n = std::max(m - l, l), short_n = std::min(m - l, l);
+    size_t sbn = long_n + 1;
+    limb_t* sb = sa + hi + 1;
+    std::copy(b_long, b_long + long_n, sb);
+    sb[long_n] = add_limbs(sb, long_n, b_short, short_n);
+
+    // z1 = sa * sb - z0 - z2
+    size_t z1n = hi + 1 + sbn;
+    limb_t* z1 = sb + sbn;
+    mul_limbs(z1, sa, hi + 1, sb, sbn, z1 + z1n);
+    sub_limbs(z1, z1n, r, 2 * l);
+    sub_limbs(z1, z1n, r + 2 * l, n + m - 2 * l);
+
+    // Các limb của z1 vượt quá n + m - l chắc chắn bằng 0
+    add_limbs(r + l, n + m - l, z1, std::min(z1n, n + m - l));
+}
+
+void BigIntBinary::mul_limbs(limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m, limb_t* scratch) {
+    if (n < m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+
+    // Dưới 4 limb thì tích (a0 + a1)(b0 + b1) không còn nhỏ hơn bài toán ban đầu
+    if (m < karatsuba_threshold()) {
+        mul_basecase_limbs(r, a, n, b, m);
+        return;
+    }
+
+    // Hai toán hạng chênh lệch nhiều: cắt a thành các khúc cỡ m
+    if (n >= 2 * m) {
+        std::fill(r, r + n + m, 0);
+        limb_t* piece = scratch;
+        for (size_t i = 0; i < n; i += m) {
+            size_t len = std::min(m, n - i);
+            mul_limbs(piece, a + i, len, b, m, scratch + 2 * m);
+            add_limbs(r + i, n + m - i, piece, len + m);
+        }
+        return;
+    }
+
+    mul_karatsuba_limbs(r, a, n, b, m, scratch);
+}
+
+limb_t* BigIntBinary::scratch_buffer(size_t n) {
+    thread_local std::vector<limb_t> buffer;
+    if (buffer.size() < n) {
+        buffer.resize(n);
+    }
+    return buffer.data();
+}
+
+void BigIntBinary::multiply_into(const BigIntBinary& a, const BigIntBinary& b, BigIntBinary& out) {
+    if (&out == &a || &out == &b) {
+        BigIntBinary result;
+        multiply_into(a, b, result);
+        out.swap(result);
+        return;
+    }
+
+    const BigIntBinary& big = a.limbs.size() >= b.limbs.size() ? a : b;
+    const BigIntBinary& small = a.limbs.size() >= b.limbs.size() ? b : a;
+    size_t n = big.limbs.size();
+    size_t m = small.limbs.size();
+
+    if (m == 0) {
+        out.limbs.clear();
+        return;
+    }
+
+    // Số rất lớn: Toom-3 (làm việc trên BigIntBinary, mỗi tích con quay lại hàm này)
+    if (m >= toom3_threshold()) {
+        if (n >= 2 * m) {
+            out.limbs.assign(n + m, 0);
+            BigIntBinary piece;
+            for (size_t i = 0; i < n; i += m) {
+                multiply_into(big.slice(i, i + m), small, piece);
+                out.add_shifted(piece, i);
+            }
+            out.normalize();
+        }
+        else {
+            out = mul_toom3(a, b);
+        }
+        return;
+    }
+
+    out.limbs.resize(n + m);
+    mul_limbs(out.limbs.data(), big.limbs.data(), n, small.limbs.data(), m, scratch_buffer(4 * (n + m) + 256));
+    out.normalize();
+}
+
+BigIntBinary BigIntBinary::mul_schoolbook(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary result;
+    size_t n = a.limbs.size();
+    size_t m = b.limbs.size();
+
+    if (n == 0 || m == 0) {
+        return result;
+    }
+
+    result.limbs.resize(n + m);
+    mul_basecase_limbs(result.limbs.data(), a.limbs.data(), n, b.limbs.data(), m);
+    result.normalize();
+    return result;
+}
+
+// Một tầng Karatsuba, các tích con đi qua mul_limbs (dùng cho dò ngưỡng)
+BigIntBinary BigIntBinary::mul_karatsuba(const BigIntBinary& a, const BigIntBinary& b) {
+    const BigIntBinary& big = a.limbs.size() >= b.limbs.size() ? a : b;
+    const BigIntBinary& small = a.limbs.size() >= b.limbs.size() ? b : a;
+    size_t n = big.limbs.size();
+    size_t m = small.limbs.size();
+
+    BigIntBinary result;
+    if (m < 4 || n >= 2 * m) {
+        multiply_into(a, b, result);
+        return result;
+    }
+
+    result.limbs.resize(n + m);
+    mul_karatsuba_limbs(result.limbs.data(), big.limbs.data(), n, small.limbs.data(), m, scratch_buffer(4 * (n + m) + 256));
+    result.normalize();
+    return result;
+}
+
+// Toom-Cook-3: 5 phép nhân một phần ba kích thước thay cho 9
+// Nội suy tại các điểm 0, 1, 2, 3, vô cùng để mọi giá trị trung gian đều không âm
+BigIntBinary BigIntBinary::mul_toom3(const BigIntBinary& a, const BigIntBinary& b) {
+    size_t k = (std::max(a.limbs.size(), b.limbs.size()) + 2) / 3;
+
+    BigIntBinary a0 = a.slice(0, k), a1 = a.slice(k, 2 * k), a2 = a.slice(2 * k, a.limbs.size());
+    BigIntBinary b0 = b.slice(0, k), b1 = b.slice(k, 2 * k), b2 = b.slice(2 * k, b.limbs.size());
+
+    // Giá trị của đa thức tại x = 1, 2, 3
+    BigIntBinary pa1 = a0 + a1 + a2, pb1 = b0 + b1 + b2;
+    BigIntBinary pa2 = a2, pb2 = b2;
+    pa2.multiply_by_int(2); pa2 += a1; pa2.multiply_by_int(2); pa2 += a0;
+    pb2.multiply_by_int(2); pb2 += b1; pb2.multiply_by_int(2); pb2 += b0;
+    BigIntBinary pa3 = a2, pb3 = b2;
+    pa3.multiply_by_int(3); pa3 += a1; pa3.multiply_by_int(3); pa3 += a0;
+    pb3.multiply_by_int(3); pb3 += b1; pb3.multiply_by_int(3); pb3 += b0;
+
+    BigIntBinary c0, c4, v1, v2, v3;
+    multiply_into(a0, b0, c0);
+    multiply_into(a2, b2, c4);
+    multiply_into(pa1, pb1, v1);
+    multiply_into(pa2, pb2, v2);
+    multiply_into(pa3, pb3, v3);
+
+    // w1 = c1 + c2 + c3
+    v1 -= c0;
+    v1 -= c4;
+    // w2 = (v2 - c0 - 16 c4) / 2 = c1 + 2 c2 + 4 c3
+    BigIntBinary t = c4;
+    t.multiply_by_int(16);
+    v2 -= c0;
+    v2 -= t;
+    v2.divide_by_int(2);
+    // w3 = (v3 - c0 - 81 c4) / 3 = c1 + 3 c2 + 9 c3
+    t = c4;
+    t.multiply_by_int(81);
+    v3 -= c0;
+    v3 -= t;
+    v3.divide_by_int(3);
+    // d2 = w3 - w2 = c2 + 5 c3, d1 = w2 - w1 = c2 + 3 c3
+    v3 -= v2;
+    v2 -= v1;
+    // c3 = (d2 - d1) / 2, c2 = d1 - 3 c3, c1 = w1 - c2 - c3
+    BigIntBinary c3 = v3 - v2;
+    c3.divide_by_int(2);
+    t = c3;
+    t.multiply_by_int(3);
+    BigIntBinary c2 = v2 - t;
+    BigIntBinary c1 = v1 - c2;
+    c1 -= c3;
+
+    BigIntBinary result;
+    result.limbs.reserve(a.limbs.size() + b.limbs.size() + 1);
+    result.add_shifted(c0, 0);
+    result.add_shifted(c1, k);
+    result.add_shifted(c2, 2 * k);
+    result.add_shifted(c3, 3 * k);
+    result.add_shifted(c4, 4 * k);
+    result.normalize();
+    return result;
+}
+
+// --- Bình phương ---
+// Tính các tích chéo a[i] * a[j] (i < j) một lần, nhân đôi rồi cộng các bình phương a[i]^2
+void BigIntBinary::sqr_schoolbook_limbs(limb_t* r, const limb_t* a, size_t n) {
+    std::fill(r, r + 2 * n, 0);
+
+    for (size_t i = 0; i < n; ++i) {
+        dlimb_t carry = 0;
+        for (size_t j = i + 1; j < n; ++j) {
+            dlimb_t product = (dlimb_t)a[i] * a[j] + r[i + j] + carry;
+
+            r[i + j] = (limb_t)product;
+            carry = product >> LIMB_BITS;
+        }
+        r[i + n] = (limb_t)carry;
+    }
+
+    // Nhân đôi tổng các tích chéo
+    limb_t top = 0;
+    for (size_t i = 0; i < 2 * n; ++i) {
+        limb_t next_top = r[i] >> (LIMB_BITS - 1);
+        r[i] = (r[i] << 1) | top;
+        top = next_top;
+    }
+
+    // Cộng các số hạng trên đường chéo
+    dlimb_t carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        dlimb_t product = (dlimb_t)a[i] * a[i];
+        dlimb_t sum = (dlimb_t)r[2 * i] + (limb_t)product + carry;
+        r[2 * i] = (limb_t)sum;
+        sum = (dlimb_t)r[2 * i + 1] + (product >> LIMB_BITS) + (sum >> LIMB_BITS);
+        r[2 * i + 1] = (limb_t)sum;
+        carry = sum >> LIMB_BITS;
+    }
+}
+
+// a^2 = z2 * B^2l + ((a0 + a1)^2 - z0 - z2) * B^l + z0
+void BigIntBinary::sqr_karatsuba_limbs(limb_t* r, const limb_t* a, size_t n, limb_t* scratch) {
+    size_t l = n / 2;
+    size_t hi = n - l;
+
+    sqr_limbs(r, a, l, scratch);
+    sqr_limbs(r + 2 * l, a + l, hi, scratch);
+
+    limb_t* sa = scratch;
+    std::copy(a + l, a + n, sa);
+    sa[hi] = add_limbs(sa, hi, a, l);
+
+    size_t z1n = 2 * (hi + 1);
+    limb_t* z1 = sa + hi + 1;
+    sqr_limbs(z1, sa, hi + 1, z1 + z1n);
+    sub_limbs(z1, z1n, r, 2 * l);
+    sub_limbs(z1, z1n, r + 2 * l, 2 * hi);
+
+    add_limbs(r + l, 2 * n - l, z1, std::min(z1n, 2 * n - l));
+}
+
+void BigIntBinary::sqr_limbs(limb_t* r, const limb_t* a, size_t n, limb_t* scratch) {
+    if (n < karatsuba_threshold()) {
+        sqr_basecase_limbs(r, a, n);
+        return;
+    }
+    sqr_karatsuba_limbs(r, a, n, scratch);
+}
+
+void BigIntBinary::square_into(const BigIntBinary& a, BigIntBinary& out) {
+    if (&out == &a) {
+        BigIntBinary result;
+        square_into(a, result);
+        out.swap(result);
+        return;
+    }
+
+    size_t n = a.limbs.size();
+    if (n == 0) {
+        out.limbs.clear();
+        return;
+    }
+    if (n >= toom3_threshold()) {
+        out = sqr_toom3(a);
+        return;
+    }
+
+    out.limbs.resize(2 * n);
+    sqr_limbs(out.limbs.data(), a.limbs.data(), n, scratch_buffer(4 * n + 256));
+    out.normalize();
+}
+
+// Cùng cách nội suy với mul_toom3, 5 phép bình phương
+BigIntBinary BigIntBinary::sqr_toom3(const BigIntBinary& a) {
+    size_t k = (a.limbs.size() + 2) / 3;
+
+    BigIntBinary a0 = a.slice(0, k), a1 = a.slice(k, 2 * k), a2 = a.slice(2 * k, a.limbs.size());
+
+    BigIntBinary pa1 = a0 + a1 + a2;
+    BigIntBinary pa2 = a2;
+    pa2.multiply_by_int(2); pa2 += a1; pa2.multiply_by_int(2); pa2 += a0;
+    BigIntBinary pa3 = a2;
+    pa3.multiply_by_int(3); pa3 += a1; pa3.multiply_by_int(3); pa3 += a0;
+
+    BigIntBinary c0, c4, v1, v2, v3;
+    square_into(a0, c0);
+    square_into(a2, c4);
+    square_into(pa1, v1);
+    square_into(pa2, v2);
+    square_into(pa3, v3);
+
+    v1 -= c0;
+    v1 -= c4;
+    BigIntBinary t = c4;
+    t.multiply_by_int(16);
+    v2 -= c0;
+    v2 -= t;
+    v2.divide_by_int(2);
+    t = c4;
+    t.multiply_by_int(81);
+    v3 -= c0;
+    v3 -= t;
+    v3.divide_by_int(3);
+    v3 -= v2;
+    v2 -= v1;
+    BigIntBinary c3 = v3 - v2;
+    c3.divide_by_int(2);
+    t = c3;
+    t.multiply_by_int(3);
+    BigIntBinary c2 = v2 - t;
+    BigIntBinary c1 = v1 - c2;
+    c1 -= c3;
+
+    BigIntBinary result;
+    result.limbs.reserve(2 * a.limbs.size() + 1);
+    result.add_shifted(c0, 0);
+    result.add_shifted(c1, k);
+    result.add_shifted(c2, 2 * k);
+    result.add_shifted(c3, 3 * k);
+    result.add_shifted(c4, 4 * k);
+    result.normalize();
+    return result;
+}
+
+// --- Dò ngưỡng nhân cho máy hiện tại ---
+// Thời gian trung bình (ns) của một lần gọi op(), lặp đến khi đủ khoảng 20ms
+template <typename Op>
+static double time_operation(Op op) {
+    long long reps = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < reps; ++i) {
+            op();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (ns >= 2e7) {
+            return ns / reps;
+        }
+        reps *= 2;
+    }
+}
+
+static double time_multiplication(BigIntBinary (*mul)(const BigIntBinary&, const BigIntBinary&),
+    const BigIntBinary& a, const BigIntBinary& b) {
+    return time_operation([&]() { BigIntBinary r = mul(a, b); });
+}
+
+void tune_multiplication_thresholds() {
+    std::mt19937_64 gen(12345);
+    auto random_number = [&gen](size_t n) {
+        BigIntBinary x;
+        x.limbs.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            x.limbs[i] = (limb_t)gen();
+        }
+        x.limbs[n - 1] |= LIMB_HIGH_BIT;
+        return x;
+    };
+
+    // Dò ngưỡng của trường hợp cơ sở đang dùng (schoolbook hoặc kernel SIMD)
+    MulKernel kernel = active_mul_kernel();
+    bool simd = kernel != MulKernel::Scalar;
+    size_t& karatsuba_threshold = simd ? SIMD_THRESHOLDS[(int)kernel].karatsuba : KARATSUBA_THRESHOLD;
+    std::cout << "kernel: " << mul_kernel_name(kernel) << std::endl;
+
+    // 0. Kernel SIMD so với schoolbook, riêng cho tích và bình phương
+    if (simd) {
+        SimdThresholds& t = SIMD_THRESHOLDS[(int)kernel];
+        std::vector<limb_t> r(512);
+        size_t mul_from = SIZE_MAX, sqr_from = SIZE_MAX;
+        int mul_wins = 0, sqr_wins = 0;
+        std::cout << "limbs  schoolbook(ns)  simd(ns)  sqr_schoolbook(ns)  sqr_simd(ns)" << std::endl;
+        for (size_t n = 4; n <= 256 && (mul_wins < 2 || sqr_wins < 2); n += 4) {
+            BigIntBinary a = random_number(n), b = random_number(n);
+            const limb_t* x = a.limbs.data();
+            const limb_t* y = b.limbs.data();
+            double t_school = time_operation([&]() { BigIntBinary::mul_schoolbook_limbs(r.data(), x, n, y, n); });
+            double t_simd = time_operation([&]() { mul_simd_limbs(kernel, r.data(), x, n, y, n); });
+            double t_sqr_school = time_operation([&]() { BigIntBinary::sqr_schoolbook_limbs(r.data(), x, n); });
+            double t_sqr_simd = time_operation([&]() { mul_simd_limbs(kernel, r.data(), x, n, x, n); });
+            std::cout << n << "  " << (long long)t_school << "  " << (long long)t_simd << "  "
+                      << (long long)t_sqr_school << "  " << (long long)t_sqr_simd << std::endl;
+
+            if (mul_wins < 2) {
+                mul_wins = t_simd < t_school ? mul_wins + 1 : 0;
+                if (mul_wins == 1) mul_from = n;
+            }
+            if (sqr_wins < 2) {
+                sqr_wins = t_sqr_simd < t_sqr_school ? sqr_wins + 1 : 0;
+                if (sqr_wins == 1) sqr_from = n;
+            }
+        }
+        t.mul = mul_wins == 2 ? mul_from : SIZE_MAX;
+        t.sqr = sqr_wins == 2 ? sqr_from : SIZE_MAX;
+    }
+
+    // 1. Karatsuba một tầng (các tích con dùng trường hợp cơ sở) so với trường hợp cơ sở
+    karatsuba_threshold = SIZE_MAX;
+    TOOM3_THRESHOLD = SIZE_MAX;
+    size_t karatsuba = 0;
+    int wins = 0;
+    std::cout << "limbs  basecase(ns)  karatsuba(ns)" << std::endl;
+    for (size_t n = 8; n <= 512; n += 8) {
+        BigIntBinary a = random_number(n), b = random_number(n);
+        double t_school = time_multiplication(BigIntBinary::mul_schoolbook, a, b);
+        double t_kara = time_multiplication(BigIntBinary::mul_karatsuba, a, b);
+        std::cout << n << "  " << (long long)t_school << "  " << (long long)t_kara << std::endl;
+
+        // Cần thắng 2 lần liên tiếp để tránh nhiễu
+        wins = t_kara < t_school ? wins + 1 : 0;
+        if (wins == 1) karatsuba = n;
+        if (wins == 2) break;
+    }
+    if (wins < 2) karatsuba = 512;
+    karatsuba_threshold = karatsuba;
+
+    // 2. Toom-3 một tầng so với Karatsuba một tầng (tích con dùng ngưỡng vừa tìm)
+    size_t toom = 0;
+    wins = 0;
+    std::cout << "limbs  karatsuba(ns)  toom3(ns)" << std::endl;
+    for (size_t n = 2 * karatsuba; n <= 4096; n += n / 4) {
+        BigIntBinary a = random_number(n), b = random_number(n);
+        double t_kara = time_multiplication(BigIntBinary::mul_karatsuba, a, b);
+        double t_toom = time_multiplication(BigIntBinary::mul_toom3, a, b);
+        std::cout << n << "  " << (long long)t_kara << "  " << (long long)t_toom << std::endl;
+
+        wins = t_toom < t_kara ? wins + 1 : 0;
+        if (wins == 1) toom = n;
+        if (wins == 2) break;
+    }
+    if (wins < 2) toom = SIZE_MAX;
+    TOOM3_THRESHOLD = toom;
+
+    if (simd) {
+        const SimdThresholds& t = SIMD_THRESHOLDS[(int)kernel];
+        std::cout << "SIMD_THRESHOLDS[" << mul_kernel_name(kernel) << "] = { " << t.mul << ", " << t.sqr << ", "
+                  << t.karatsuba << " }" << std::endl;
+    }
+    else {
+        std::cout << "KARATSUBA_THRESHOLD = " << KARATSUBA_THRESHOLD << std::endl;
+    }
+    if (TOOM3_THRESHOLD == SIZE_MAX) {
+        std::cout << "TOOM3_THRESHOLD = (khong dung Toom-3)" << std::endl;
+    } else {
+        std::cout << "TOOM3_THRESHOLD = " << TOOM3_THRESHOLD << std::endl;
+    }
+}
+
+// --- Kiểm tra chéo các kernel nhân ---
+// Tích và bình phương của số ngẫu nhiên (và số toàn bit 1 để dồn carry) qua từng kernel SIMD
+// phải trùng từng bit với bản vô hướng; kích thước trải từ vài limb đến vượt ngưỡng Karatsuba.
+bool check_mul_kernels(size_t rounds) {
+    std::mt19937_64 gen(2024);
+    auto random_number = [&gen](size_t bytes, bool ones) {
+        std::vector<uint8_t> data(bytes);
+        for (uint8_t& x : data) {
+            x = ones ? 0xFF : (uint8_t)gen();
+        }
+        return BigIntBinary::from_bytes(data.data(), data.size());
+    };
+
+    MulKernel saved = active_mul_kernel();
+    bool ok = true;
+    for (MulKernel kernel : { MulKernel::Avx2, MulKernel::Avx512Ifma }) {
+        if (!mul_kernel_supported(kernel)) {
+            std::cout << mul_kernel_name(kernel) << ": khong duoc CPU ho tro" << std::endl;
+            continue;
+        }
+        size_t failures = 0;
+        for (size_t r = 0; r < rounds; ++r) {
+            size_t b_bytes = 1 + gen() % (r % 4 == 0 ? 2048 : 640);
+            size_t a_bytes = b_bytes + gen() % 1024;
+            BigIntBinary a = random_number(a_bytes, r % 16 == 1);
+            BigIntBinary b = random_number(b_bytes, r % 16 == 2);
+
+            set_mul_kernel(MulKernel::Scalar);
+            BigIntBinary expected_product = a * b;
+            BigIntBinary expected_square = b;
+            expected_square.square();
+
+            set_mul_kernel(kernel);
+            BigIntBinary product = a * b;
+            BigIntBinary square = b;
+            square.square();
+
+            if (!(product == expected_product) || !(square == expected_square)) {
+                if (failures++ == 0) {
+                    std::cout << mul_kernel_name(kernel) << ": sai voi " << a_bytes * 8 << " x " << b_bytes * 8 << " bit" << std::endl;
+                }
+            }
+        }
+        std::cout << mul_kernel_name(kernel) << ": " << rounds - failures << "/" << rounds << " dung" << std::endl;
+        ok = ok && failures == 0;
+    }
+    set_mul_kernel(saved);
+    return ok;
+}
+
+void BigIntBinary::divide(const BigIntBinary& divisor, BigIntBinary& quotient, BigIntBinary& remainder) const {
+    if (divisor.is_zero()) {
+        throw std::runtime_error("Division by zero");
+    }
+
+    // Số bị chia nhỏ hơn số chia: thương bằng 0
+    if (*this < divisor) {
+        remainder = *this;
+        quotient = BigIntBinary(0);
+        return;
+    }
+
+    size_t n = divisor.limbs.size();
+    size_t m = limbs.size() - n;
+    Limbs q(m + 1, 0);
+
+    // Số chia chỉ có 1 limb: chia ngắn từ limb cao xuống
+    if (n == 1) {
+        dlimb_t d = divisor.limbs[0];
+        dlimb_t rem = 0;
+        for (int i = (int)limbs.size() - 1; i >= 0; --i) {
+            dlimb_t cur = (rem << LIMB_BITS) | limbs[i];
+            q[i] = (limb_t)(cur / d);
+            rem = cur % d;
+        }
+        quotient.limbs.swap(q);
+        quotient.normalize();
+        remainder = BigIntBinary(rem);
+        return;
+    }
+
+    // D1. Chuẩn hóa: dịch trái để bit cao nhất của số chia bằng 1
+    int shift = count_leading_zeros(divisor.limbs.back());
+
+    Limbs vn(n, 0);
+    Limbs un(m + n + 1, 0);
+    for (size_t i = n - 1; i > 0; --i) {
+        vn[i] = (divisor.limbs[i] << shift) | (shift ? divisor.limbs[i - 1] >> (LIMB_BITS - shift) : 0);
+    }
+    vn[0] = divisor.limbs[0] << shift;
+
+    un[m + n] = shift ? limbs[m + n - 1] >> (LIMB_BITS - shift) : 0;
+    for (size_t i = m + n - 1; i > 0; --i) {
+        un[i] = (limbs[i] << shift) | (shift ? limbs[i - 1] >> (LIMB_BITS - shift) : 0);
+    }
+    un[0] = limbs[0] << shift;
+
+    // D2-D7. Mỗi vòng tìm một limb của thương
+    for (int j = (int)m; j >= 0; --j) {
+        // D3. Ước lượng qhat từ 2 limb cao của phần dư và limb cao của số chia
+        dlimb_t num = ((dlimb_t)un[j + n] << LIMB_BITS) | un[j + n - 1];
+        dlimb_t qhat = num / vn[n - 1];
+        dlimb_t rhat = num % vn[n - 1];
+        while (qhat >= BASE || qhat * vn[n - 2] > ((rhat << LIMB_BITS) | un[j + n - 2])) {
+            qhat--;
+            rhat += vn[n - 1];
+            if (rhat >= BASE) break;
+        }
+
+        // D4. Nhân và trừ: un[j..j+n] -= qhat * vn
+        limb_t borrow = 0;
+        dlimb_t carry = 0;
+        for (size_t i = 0; i < n; ++i) {
+            dlimb_t product = qhat * vn[i] + carry;
+            carry = product >> LIMB_BITS;
+            dlimb_t diff = (dlimb_t)un[i + j] - (limb_t)product - borrow;
+            un[i + j] = (limb_t)diff;
+            borrow = (limb_t)(diff >> (2 * LIMB_BITS - 1));
+        }
+        dlimb_t diff = (dlimb_t)un[j + n] - carry - borrow;
+        un[j + n] = (limb_t)diff;
+
+        // D5-D6. qhat lớn hơn 1 (hiếm): giảm thương và cộng trả lại số chia
+        q[j] = (limb_t)qhat;
+        if (diff >> (2 * LIMB_BITS - 1)) {
+            q[j]--;
+            dlimb_t c = 0;
+            for (size_t i = 0; i < n; ++i) {
+                dlimb_t sum = (dlimb_t)un[i + j] + vn[i] + c;
+                un[i + j] = (limb_t)sum;
+                c = sum >> LIMB_BITS;
+            }
+            un[j + n] += (limb_t)c;
+        }
+    }
+
+    // D8. Phần dư = un[0..n) dịch phải lại
+    Limbs r(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        r[i] = (un[i] >> shift) | (shift ? un[i + 1] << (LIMB_BITS - shift) : 0);
+    }
+
+    quotient.limbs.swap(q);
+    quotient.normalize();
+    remainder.limbs.swap(r);
+    remainder.normalize();
+}
+
+BigIntBinary& BigIntBinary::operator/=(const BigIntBinary& other) {
+    BigIntBinary quotient, remainder;
+    this->divide(other, quotient, remainder);
+    swap(quotient);
+    return *this;
+}
+
+BigIntBinary& BigIntBinary::operator%=(const BigIntBinary& other) {
+    BigIntBinary quotient, remainder;
+    this->divide(other, quotient, remainder);
+    swap(remainder);
+    return *this;
+}
+
+// --- Các toán tử tiện ích ---
+BigIntBinary operator+(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary temp = a; 
+    temp += b; 
+    return temp;
+}
+BigIntBinary operator-(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary temp = a; 
+    temp -= b; 
+    return temp;
+}
+BigIntBinary operator*(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary result;
+    BigIntBinary::multiply_into(a, b, result);
+    return result;
+}
+BigIntBinary operator/(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary temp = a; 
+    temp /= b; 
+    return temp;
+}
+BigIntBinary operator%(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary temp = a; 
+    temp %= b; 
+    return temp;
+}
+
+// Toán hạng trái là giá trị tạm: tính thẳng trên nó, không sao chép
+BigIntBinary operator+(BigIntBinary&& a, const BigIntBinary& b) {
+    a += b;
+    return std::move(a);
+}
+BigIntBinary operator-(BigIntBinary&& a, const BigIntBinary& b) {
+    a -= b;
+    return std::move(a);
+}
+BigIntBinary operator/(BigIntBinary&& a, const BigIntBinary& b) {
+    a /= b;
+    return std::move(a);
+}
+BigIntBinary operator%(BigIntBinary&& a, const BigIntBinary& b) {
+    a %= b;
+    return std::move(a);
+}
+
+bool operator!=(const BigIntBinary& a, const BigIntBinary& b) {
+    return !(a == b);
+}
+bool operator>(const BigIntBinary& a, const BigIntBinary& b) {
+    return b < a;
+}
+bool operator<=(const BigIntBinary& a, const BigIntBinary& b) {
+    return !(b < a);
+}
+bool operator>=(const BigIntBinary& a, const BigIntBinary& b) {
+    return !(a < b);
+}
+
+
+
+// --- Ngữ cảnh Montgomery ---
+MontgomeryContext::MontgomeryContext(const BigIntBinary& modulus) : n(modulus) {
+    if (!n.is_odd()) {
+        throw std::runtime_error("Montgomery modulus must be odd");
+    }
+    k = n.limbs.size();
+
+    // Newton: x = n0^(-1) mod 2^LIMB_BITS, mỗi vòng gấp đôi số bit đúng (3 -> 96 bit)
+    limb_t n0 = n.limbs[0];
+    limb_t x = n0;
+    for (int i = 0; i < 5; i++) {
+        x *= 2 - n0 * x;
+    }
+    n0_inv = (limb_t)(0 - x);
+
+    // R^2 mod n: chỉ chia một lần khi dựng ngữ cảnh
+    r2 = BigIntBinary(0);
+    r2.set_bit((int)(2 * LIMB_BITS * k));
+    r2 %= n;
+
+    // R mod n = REDC(R^2)
+    one = r2;
+    redc(one);
+
+    select_kernel();
+}
+
+MontgomeryContext::MontgomeryContext(const BigIntBinary& modulus, limb_t n0_inv, const BigIntBinary& r2, const BigIntBinary& one)
+    : n(modulus), k(modulus.limbs.size()), n0_inv(n0_inv), r2(r2), one(one) {
+    select_kernel();
+}
+
+void MontgomeryContext::select_kernel() {
+    switch (k * LIMB_BITS) {
+    case 512:  mul_fixed = mont_mul_fixed<512 / LIMB_BITS>; break;
+    case 1024: mul_fixed = mont_mul_fixed<1024 / LIMB_BITS>; break;
+    case 1536: mul_fixed = mont_mul_fixed<1536 / LIMB_BITS>; break;
+    case 2048: mul_fixed = mont_mul_fixed<2048 / LIMB_BITS>; break;
+    case 3072: mul_fixed = mont_mul_fixed<3072 / LIMB_BITS>; break;
+    case 4096: mul_fixed = mont_mul_fixed<4096 / LIMB_BITS>; break;
+    default:   mul_fixed = nullptr; break;
+    }
+    mul_ct_fixed = mul_fixed;
+    // Từ ngưỡng Karatsuba trở lên, nhân Karatsuba + REDC nhanh hơn CIOS
+    if (k >= KARATSUBA_THRESHOLD) {
+        mul_fixed = nullptr;
+    }
+}
+
+// CIOS: mỗi vòng cộng a * b[i] rồi triệt tiêu limb thấp nhất, t luôn có K + 2 limb
+// Yêu cầu a, b < n và đều có đúng K limb (thiếu thì bù 0)
+template <size_t K>
+void MontgomeryContext::mont_mul_fixed(limb_t* r, const limb_t* a, const limb_t* b, const limb_t* n, limb_t n0_inv) {
+    limb_t t[K + 2];
+    mont_mul_ct(r, a, b, n, n0_inv, K, t);
+}
+
+// Yêu cầu a, b < n và đều có đúng k limb (thiếu thì bù 0); r có thể trùng a hoặc b vì chỉ ghi r ở cuối.
+// Hàm inline được nên với k cố định lúc biên dịch (mont_mul_fixed) trình biên dịch trải được vòng lặp.
+inline void MontgomeryContext::mont_mul_ct(limb_t* r, const limb_t* a, const limb_t* b, const limb_t* n,
+                                           limb_t n0_inv, size_t k, limb_t* t) {
+    std::fill(t, t + k + 2, 0);
+
+    for (size_t i = 0; i < k; ++i) {
+        dlimb_t carry = 0;
+        for (size_t j = 0; j < k; ++j) {
+            dlimb_t cur = (dlimb_t)a[j] * b[i] + t[j] + carry;
+            t[j] = (limb_t)cur;
+            carry = cur >> LIMB_BITS;
+        }
+        dlimb_t sum = (dlimb_t)t[k] + carry;
+        t[k] = (limb_t)sum;
+        t[k + 1] = (limb_t)(sum >> LIMB_BITS);
+
+        limb_t m = t[0] * n0_inv;
+        dlimb_t cur = (dlimb_t)m * n[0] + t[0];
+        carry = cur >> LIMB_BITS;
+        for (size_t j = 1; j < k; ++j) {
+            cur = (dlimb_t)m * n[j] + t[j] + carry;
+            t[j - 1] = (limb_t)cur;
+            carry = cur >> LIMB_BITS;
+        }
+        sum = (dlimb_t)t[k] + carry;
+        t[k - 1] = (limb_t)sum;
+        t[k] = t[k + 1] + (limb_t)(sum >> LIMB_BITS);
+    }
+
+    ct_reduce_once(r, t, t[k], n, k);
+}
+
+// Kết quả trước khi trừ < 2n nên top chỉ là 0 hoặc 1; t - n âm khi có borrow và top = 0
+inline void MontgomeryContext::ct_reduce_once(limb_t* r, const limb_t* t, limb_t top, const limb_t* n, size_t k) {
+    limb_t borrow = 0;
+    for (size_t j = 0; j < k; ++j) {
+        dlimb_t diff = (dlimb_t)t[j] - n[j] - borrow;
+        r[j] = (limb_t)diff;
+        borrow = (limb_t)(diff >> (2 * LIMB_BITS - 1));
+    }
+    limb_t keep_t = (limb_t)0 - (borrow & (top ^ 1));
+    for (size_t j = 0; j < k; ++j) {
+        r[j] = (r[j] & ~keep_t) | (t[j] & keep_t);
+    }
+}
+
+// Carry ra khỏi limb i + k được giữ trong top và cộng ở vòng sau, thay cho vòng lan truyền có độ dài thay đổi
+void MontgomeryContext::mont_sqr_ct(limb_t* r, const limb_t* a, const limb_t* n, limb_t n0_inv, size_t k, limb_t* t) {
+    BigIntBinary::sqr_schoolbook_limbs(t, a, k);
+
+    limb_t top = 0;
+    for (size_t i = 0; i < k; ++i) {
+        limb_t m = t[i] * n0_inv;
+        dlimb_t carry = 0;
+        for (size_t j = 0; j < k; ++j) {
+            dlimb_t cur = (dlimb_t)m * n[j] + t[i + j] + carry;
+            t[i + j] = (limb_t)cur;
+            carry = cur >> LIMB_BITS;
+        }
+        dlimb_t sum = (dlimb_t)t[i + k] + carry + top;
+        t[i + k] = (limb_t)sum;
+        top = (limb_t)(sum >> LIMB_BITS);
+    }
+    ct_reduce_once(r, t + k, top, n, k);
+}
+
+void MontgomeryContext::mul_ct(limb_t* r, const limb_t* a, const limb_t* b, limb_t* t) const {
+    if (mul_ct_fixed) {
+        mul_ct_fixed(r, a, b, n.limbs.data(), n0_inv);
+    }
+    else {
+        mont_mul_ct(r, a, b, n.limbs.data(), n0_inv, k, t);
+    }
+}
+
+void MontgomeryContext::redc(BigIntBinary& t) const {
+    // Yêu cầu t < n * R, kết quả t * R^(-1) mod n
+    t.limbs.resize(2 * k + 1, 0);
+
+    for (size_t i = 0; i < k; ++i) {
+        // Chọn m để limb thứ i của t triệt tiêu
+        limb_t m = t.limbs[i] * n0_inv;
+        dlimb_t carry = 0;
+        for (size_t j = 0; j < k; ++j) {
+            dlimb_t cur = (dlimb_t)m * n.limbs[j] + t.limbs[i + j] + carry;
+            t.limbs[i + j] = (limb_t)cur;
+            carry = cur >> LIMB_BITS;
+        }
+        for (size_t j = i + k; carry > 0; ++j) {
+            dlimb_t sum = (dlimb_t)t.limbs[j] + carry;
+            t.limbs[j] = (limb_t)sum;
+            carry = sum >> LIMB_BITS;
+        }
+    }
+
+    // Chia cho R = bỏ k limb thấp (đều đã bằng 0)
+    t.limbs.erase(t.limbs.begin(), t.limbs.begin() + k);
+    t.normalize();
+    if (t >= n) {
+        t -= n;
+    }
+}
+
+BigIntBinary MontgomeryContext::to_mont(const BigIntBinary& a) const {
+    if (a >= n) {
+        return mul(a % n, r2);
+    }
+    return mul(a, r2);
+}
+
+BigIntBinary MontgomeryContext::from_mont(const BigIntBinary& a) const {
+    BigIntBinary t = a;
+    redc(t);
+    return t;
+}
+
+BigIntBinary MontgomeryContext::mul(const BigIntBinary& a, const BigIntBinary& b) const {
+    BigIntBinary t;
+    mul(a, b, t);
+    return t;
+}
+
+BigIntBinary MontgomeryContext::sqr(const BigIntBinary& a) const {
+    BigIntBinary t;
+    sqr(a, t);
+    return t;
+}
+
+// Tích và REDC đều làm trên vùng nhớ của out, nên khi out đã đủ lớn thì không cấp phát
+void MontgomeryContext::mul(const BigIntBinary& a, const BigIntBinary& b, BigIntBinary& out) const {
+    if (mul_fixed) {
+        // Bù 0 cho đủ K limb; out có thể trùng a hoặc b vì kernel chỉ ghi r ở cuối
+        limb_t pa[4096 / LIMB_BITS], pb[4096 / LIMB_BITS];
+        const limb_t* ap = a.limbs.data();
+        const limb_t* bp = b.limbs.data();
+        if (a.limbs.size() < k) {
+            std::fill(std::copy(a.limbs.begin(), a.limbs.end(), pa), pa + k, 0);
+            ap = pa;
+        }
+        if (b.limbs.size() < k) {
+            std::fill(std::copy(b.limbs.begin(), b.limbs.end(), pb), pb + k, 0);
+            bp = pb;
+        }
+        out.limbs.resize(k);
+        mul_fixed(out.limbs.data(), ap, bp, n.limbs.data(), n0_inv);
+        out.normalize();
+        return;
+    }
+    BigIntBinary::multiply_into(a, b, out);
+    redc(out);
+}
+
+void MontgomeryContext::sqr(const BigIntBinary& a, BigIntBinary& out) const {
+    BigIntBinary::square_into(a, out);
+    redc(out);
+}
+
+// Toán hạng b là mảng limb thô (ví dụ mục bảng trong file đã ánh xạ), không cần dựng BigIntBinary.
+// Modulo Montgomery luôn nhỏ hơn nhiều so với ngưỡng Toom-3 nên chỉ cần kernel limb thô.
+void MontgomeryContext::mul(const BigIntBinary& a, const limb_t* b, BigIntBinary& out) const {
+    if (&out == &a) {
+        BigIntBinary result;
+        mul(a, b, result);
+        out.swap(result);
+        return;
+    }
+    if (mul_fixed) {
+        limb_t pa[4096 / LIMB_BITS];
+        const limb_t* ap = a.limbs.data();
+        if (a.limbs.size() < k) {
+            std::fill(std::copy(a.limbs.begin(), a.limbs.end(), pa), pa + k, 0);
+            ap = pa;
+        }
+        out.limbs.resize(k);
+        mul_fixed(out.limbs.data(), ap, b, n.limbs.data(), n0_inv);
+        out.normalize();
+        return;
+    }
+
+    size_t an = a.limbs.size();
+    size_t bn = k;
+    while (bn > 0 && b[bn - 1] == 0) {
+        bn--;
+    }
+    if (an == 0 || bn == 0) {
+        out.limbs.clear();
+        return;
+    }
+    out.limbs.resize(an + bn);
+    BigIntBinary::mul_limbs(out.limbs.data(), a.limbs.data(), an, b, bn,
+        BigIntBinary::scratch_buffer(4 * (an + bn) + 256));
+    out.normalize();
+    redc(out);
+}
+
+
+// --- Rút gọn Barrett ---
+BarrettContext::BarrettContext(const BigIntBinary& modulus) : n(modulus) {
+    if (n.is_zero()) {
+        throw std::runtime_error("Barrett modulus must be nonzero");
+    }
+    k = n.limbs.size();
+
+    // Phép chia duy nhất, làm một lần khi dựng ngữ cảnh
+    BigIntBinary b2k, remainder;
+    b2k.set_bit((int)(2 * LIMB_BITS * k));
+    b2k.divide(n, mu, remainder);
+}
+
+// q = floor(floor(x / BASE^(k-1)) * mu / BASE^(k+1)) chỉ cần các cột từ k - 1 trở lên của tích,
+// bỏ các cột thấp làm q nhỏ hơn thương đúng tối đa 3, nên r = x - q * n (chỉ cần k + 1 limb thấp
+// của q * n) nằm trong [0, 4n). Cả hai tích đều là tích một nửa, tổng cộng cỡ một phép nhân k x k.
+void BarrettContext::reduce(BigIntBinary& x) const {
+    if (x < n) {
+        return;
+    }
+    if (x.limbs.size() > 2 * k) {
+        x %= n;
+        return;
+    }
+
+    const limb_t* q1 = x.limbs.data() + (k - 1);
+    const size_t q1n = x.limbs.size() - (k - 1);
+    const limb_t* m = mu.limbs.data();
+    const size_t mn = mu.limbs.size();
+    const size_t low = k - 1;          // Cột thấp nhất được tính
+    const size_t columns = q1n + mn;   // Số cột của tích đầy đủ
+
+    // hi[c - low] = cột c của q1 * mu (c >= low)
+    limb_t* hi = BigIntBinary::scratch_buffer(2 * (columns - low) + 2 * k + 4);
+    std::fill(hi, hi + (columns - low), 0);
+    for (size_t i = 0; i < q1n; ++i) {
+        dlimb_t carry = 0;
+        for (size_t j = low > i ? low - i : 0; j < mn; ++j) {
+            dlimb_t cur = (dlimb_t)q1[i] * m[j] + hi[i + j - low] + carry;
+            hi[i + j - low] = (limb_t)cur;
+            carry = cur >> LIMB_BITS;
+        }
+        if (i + mn >= low) {
+            hi[i + mn - low] = (limb_t)carry;
+        }
+    }
+    const limb_t* q3 = hi + 2;         // Cột k + 1 trở lên
+    size_t q3n = columns > k + 1 ? columns - (k + 1) : 0;
+
+    // t = q3 * n mod BASE^(k+1)
+    limb_t* t = hi + (columns - low);
+    std::fill(t, t + k + 1, 0);
+    for (size_t i = 0; i < q3n && i <= k; ++i) {
+        dlimb_t carry = 0;
+        size_t jn = std::min(k, k + 1 - i);
+        for (size_t j = 0; j < jn; ++j) {
+            dlimb_t cur = (dlimb_t)q3[i] * n.limbs[j] + t[i + j] + carry;
+            t[i + j] = (limb_t)cur;
+            carry = cur >> LIMB_BITS;
+        }
+        if (i == 0) {
+            t[k] = (limb_t)carry;
+        }
+    }
+
+    // r = (x - t) mod BASE^(k+1)
+    x.limbs.resize(k + 1, 0);
+    BigIntBinary::sub_limbs(x.limbs.data(), k + 1, t, k + 1);
+    x.normalize();
+    while (x >= n) {
+        x -= n;
+    }
+}
+
+void BarrettContext::mul(const BigIntBinary& a, const BigIntBinary& b, BigIntBinary& out) const {
+    BigIntBinary::multiply_into(a, b, out);
+    reduce(out);
+}
+
+void BarrettContext::sqr(const BigIntBinary& a, BigIntBinary& out) const {
+    BigIntBinary::square_into(a, out);
+    reduce(out);
+}
+
+BigIntBinary operator%(const BigIntBinary& x, const BarrettContext& ctx) {
+    BigIntBinary temp = x;
+    ctx.reduce(temp);
+    return temp;
+}
+
+BigIntBinary operator%(BigIntBinary&& x, const BarrettContext& ctx) {
+    ctx.reduce(x);
+    return std::move(x);
+}
+
+BigIntBinary& operator%=(BigIntBinary& x, const BarrettContext& ctx) {
+    ctx.reduce(x);
+    return x;
+}
+
+
+// --- Lũy thừa cửa sổ trượt ---
+// Độ rộng cửa sổ theo độ dài số mũ (càng dài càng đáng tính bảng lớn hơn)
+int exponent_window_size(int bits) {
+    if (bits > 671) return 6;
+    if (bits > 239) return 5;
+    if (bits > 79) return 4;
+    if (bits > 23) return 3;
+    return 1;
+}
+
+// Duyệt số mũ từ bit cao xuống bằng get_bit, không sửa số mũ.
+// base và one đã ở miền của mul/sqr (Montgomery hoặc thường).
+// mul(x, y, out) và sqr(x, out) ghi vào out; res và tmp đổi chỗ sau mỗi bước nên không cấp phát lại.
+template <typename Mul, typename Sqr>
+static BigIntBinary sliding_window_pow(const BigIntBinary& base, const BigIntBinary& e,
+    const BigIntBinary& one, Mul mul, Sqr sqr) {
+    int bits = e.num_bits();
+    if (bits == 0) {
+        return one;
+    }
+    int w = exponent_window_size(bits);
+
+    // Bảng lũy thừa lẻ: table[i] = base^(2i + 1)
+    std::vector<BigIntBinary> table(1 << (w - 1));
+    table[0] = base;
+    if (w > 1) {
+        BigIntBinary base2;
+        sqr(base, base2);
+        for (size_t i = 1; i < table.size(); ++i) {
+            mul(table[i - 1], base2, table[i]);
+        }
+    }
+
+    BigIntBinary res = one, tmp;
+    bool started = false;
+    int i = bits - 1;
+    while (i >= 0) {
+        if (!e.get_bit(i)) {
+            if (started) {
+                sqr(res, tmp);
+                res.swap(tmp);
+            }
+            i--;
+            continue;
+        }
+
+        // Cửa sổ [j, i] dài tối đa w bit, kết thúc bằng bit 1
+        int j = std::max(i - w + 1, 0);
+        while (!e.get_bit(j)) j++;
+        int value = (int)e.get_bits(j, i - j + 1);
+
+        if (started) {
+            for (int t = j; t <= i; ++t) {
+                sqr(res, tmp);
+                res.swap(tmp);
+            }
+            mul(res, table[value >> 1], tmp);
+            res.swap(tmp);
+        }
+        else {
+            res = table[value >> 1];
+            started = true;
+        }
+        i = j - 1;
+    }
+    return res;
+}
+
+// --- Lũy thừa đồng thời (Straus) ---
+// Mỗi cơ số có bảng lũy thừa lẻ và các cửa sổ trượt riêng; cửa sổ được nhân vào tại bit thấp nhất của nó
+// trong một chuỗi bình phương chung, nên m cơ số chỉ tốn thêm các phép nhân chứ không thêm bình phương.
+template <typename Mul, typename Sqr>
+static BigIntBinary interleaved_multi_pow(const std::vector<BigIntBinary>& bases, const std::vector<BigIntBinary>& exponents,
+    const BigIntBinary& one, Mul mul, Sqr sqr) {
+    struct Window {
+        int pos;    // Bit thấp nhất của cửa sổ
+        int value;  // Giá trị lẻ của cửa sổ
+    };
+
+    size_t m = bases.size();
+    int top = 0;
+    std::vector<std::vector<BigIntBinary>> tables(m);
+    std::vector<std::vector<Window>> windows(m);
+    for (size_t i = 0; i < m; ++i) {
+        const BigIntBinary& e = exponents[i];
+        int bits = e.num_bits();
+        if (bits == 0) continue;
+        top = std::max(top, bits);
+        int w = exponent_window_size(bits);
+
+        // tables[i][j] = a_i^(2j + 1)
+        std::vector<BigIntBinary>& table = tables[i];
+        table.resize(1 << (w - 1));
+        table[0] = bases[i];
+        if (w > 1) {
+            BigIntBinary base2;
+            sqr(bases[i], base2);
+            for (size_t j = 1; j < table.size(); ++j) {
+                mul(table[j - 1], base2, table[j]);
+            }
+        }
+
+        // Các cửa sổ [j, b] từ bit cao xuống, như sliding_window_pow
+        for (int b = bits - 1; b >= 0;) {
+            if (!e.get_bit(b)) {
+                b--;
+                continue;
+            }
+            int j = std::max(b - w + 1, 0);
+            while (!e.get_bit(j)) j++;
+            int value = (int)e.get_bits(j, b - j + 1);
+            windows[i].push_back({ j, value });
+            b = j - 1;
+        }
+    }
+
+    std::vector<size_t> next(m, 0);
+    BigIntBinary res = one, tmp;
+    bool started = false;
+    for (int pos = top - 1; pos >= 0; --pos) {
+        if (started) {
+            sqr(res, tmp);
+            res.swap(tmp);
+        }
+        for (size_t i = 0; i < m; ++i) {
+            if (next[i] == windows[i].size() || windows[i][next[i]].pos != pos) continue;
+            const BigIntBinary& factor = tables[i][windows[i][next[i]].value >> 1];
+            if (started) {
+                mul(res, factor, tmp);
+                res.swap(tmp);
+            }
+            else {
+                res = factor;
+                started = true;
+            }
+            next[i]++;
+        }
+    }
+    return res;
+}
+
+BigIntBinary MontgomeryContext::pow(const BigIntBinary& a, const BigIntBinary& e) const {
+    BigIntBinary res = sliding_window_pow(to_mont(a), e, one,
+        [this](const BigIntBinary& x, const BigIntBinary& y, BigIntBinary& out) { mul(x, y, out); },
+        [this](const BigIntBinary& x, BigIntBinary& out) { sqr(x, out); });
+    return from_mont(res);
+}
+
+// Cơ số 2: mỗi bit 1 của số mũ chỉ cần nhân đôi và trừ n nếu vượt, thay cho một phép nhân
+BigIntBinary MontgomeryContext::pow_base2(const BigIntBinary& e) const {
+    BigIntBinary res = one, tmp;
+    for (int i = e.num_bits() - 1; i >= 0; --i) {
+        sqr(res, tmp);
+        res.swap(tmp);
+        if (e.get_bit(i)) {
+            res <<= 1;
+            if (res >= n) {
+                res -= n;
+            }
+        }
+    }
+    return from_mont(res);
+}
+
+// --- Lũy thừa thời gian hằng ---
+// Mặt nạ toàn bit 1 khi x == y, toàn bit 0 khi khác, không rẽ nhánh
+static inline limb_t ct_eq_mask(size_t x, size_t y) {
+    uint64_t d = (uint64_t)(x ^ y);
+    return (limb_t)0 - (limb_t)(((d | (0 - d)) >> 63) ^ 1);
+}
+
+// out |= rows[index] (mỗi hàng k limb), đọc đủ mọi hàng để mẫu truy cập bộ nhớ không phụ thuộc index
+static void ct_lookup_or(limb_t* out, const limb_t* rows, size_t count, size_t k, size_t index) {
+    for (size_t i = 0; i < count; ++i) {
+        limb_t mask = ct_eq_mask(i, index);
+        for (size_t j = 0; j < k; ++j) {
+            out[j] |= rows[i * k + j] & mask;
+        }
+    }
+}
+
+// w bit của số mũ bắt đầu từ bit pos (e có len limb); chỉ rẽ nhánh theo pos
+static inline size_t exponent_bits_at(const limb_t* e, size_t len, size_t pos, int w) {
+    size_t word = pos / LIMB_BITS, offset = pos % LIMB_BITS;
+    limb_t v = e[word] >> offset;
+    if (offset + w > (size_t)LIMB_BITS && word + 1 < len) {
+        v |= e[word + 1] << (LIMB_BITS - offset);
+    }
+    return (size_t)(v & (((limb_t)1 << w) - 1));
+}
+
+// Chép số mũ bí mật (en limb) vào len limb đệm 0. Số mũ có bit từ vị trí bits trở lên thì báo lỗi:
+// chỉ so sánh số limb và OR phần thừa của limb cao, không đếm bit của e, nên với mọi số mũ hợp lệ
+// thời gian như nhau và độ dài vòng lặp của bên gọi chỉ phụ thuộc bits công khai.
+static void load_secret_exponent(limb_t* out, size_t len, const limb_t* e, size_t en, size_t bits) {
+    if (en > len) {
+        throw std::invalid_argument("Secret exponent is longer than the exponent bound");
+    }
+    std::copy(e, e + en, out);
+    const size_t top_bits = bits % LIMB_BITS;
+    const limb_t excess = top_bits ? out[len - 1] >> top_bits : 0;
+    if (excess != 0) {
+        throw std::invalid_argument("Secret exponent is longer than the exponent bound");
+    }
+}
+
+BigIntBinary MontgomeryContext::pow_ct(const BigIntBinary& a, const BigIntBinary& e, int exp_bits) const {
+    const int w = k >= 16 ? 5 : 4;
+    const size_t entries = (size_t)1 << w;
+    const size_t bits = exp_bits > 0 ? (size_t)exp_bits : (size_t)n.num_bits();
+    const size_t exp_len = (bits + LIMB_BITS - 1) / LIMB_BITS;
+    const size_t windows = (bits + w - 1) / w;
+
+    // Vùng nhớ: bảng 2^w mục, acc, sel, số 1 thô, số mũ đệm, vùng tạm 2k + 2
+    std::vector<limb_t> buf(entries * k + 3 * k + exp_len + 2 * k + 2, 0);
+    limb_t* table = buf.data();
+    limb_t* acc = table + entries * k;
+    limb_t* sel = acc + k;
+    limb_t* raw_one = sel + k;
+    limb_t* exp = raw_one + k;
+    limb_t* t = exp + exp_len;
+    load_secret_exponent(exp, exp_len, e.limbs.data(), e.limbs.size(), bits);
+    raw_one[0] = 1;
+
+    // table[d] = a^d ở dạng Montgomery (cơ số là giá trị công khai nên to_mont không cần thời gian hằng)
+    BigIntBinary base = to_mont(a);
+    std::copy(one.limbs.begin(), one.limbs.end(), table);
+    std::copy(base.limbs.begin(), base.limbs.end(), table + k);
+    for (size_t d = 2; d < entries; ++d) {
+        mul_ct(table + d * k, table + (d - 1) * k, table + k, t);
+    }
+
+    std::copy(table, table + k, acc);
+    for (size_t i = windows; i-- > 0;) {
+        for (int s = 0; s < w; ++s) {
+            mont_sqr_ct(acc, acc, n.limbs.data(), n0_inv, k, t);
+        }
+        std::fill(sel, sel + k, 0);
+        ct_lookup_or(sel, table, entries, k, exponent_bits_at(exp, exp_len, i * w, w));
+        mul_ct(acc, acc, sel, t);
+    }
+
+    // Ra khỏi miền Montgomery: nhân với 1 thô
+    mul_ct(acc, acc, raw_one, t);
+    BigIntBinary result;
+    result.limbs.assign(acc, acc + k);
+    result.normalize();
+    return result;
+}
+
+BigIntBinary MontgomeryContext::multi_pow(const std::vector<BigIntBinary>& bases, const std::vector<BigIntBinary>& exponents) const {
+    if (bases.size() != exponents.size()) {
+        throw std::runtime_error("Base and exponent counts do not match");
+    }
+    std::vector<BigIntBinary> mont_bases;
+    mont_bases.reserve(bases.size());
+    for (const BigIntBinary& a : bases) {
+        mont_bases.push_back(to_mont(a));
+    }
+    BigIntBinary res = interleaved_multi_pow(mont_bases, exponents, one,
+        [this](const BigIntBinary& x, const BigIntBinary& y, BigIntBinary& out) { mul(x, y, out); },
+        [this](const BigIntBinary& x, BigIntBinary& out) { sqr(x, out); });
+    return from_mont(res);
+}
+
+// --- Lũy thừa với cơ số cố định ---
+FixedBaseExp::FixedBaseExp(const BigIntBinary& base, const BigIntBinary& p, int window, int max_exp_bits)
+    : ctx(p), g(base), w(window), max_bits(max_exp_bits), mapped(nullptr) {
+    if (w < 1 || w > 16) {
+        throw std::runtime_error("Invalid fixed-base window size");
+    }
+    if (max_bits <= 0) {
+        max_bits = p.num_bits();
+    }
+
+    const size_t k = ctx.size();
+    size_t digits = (1u << w) - 1;
+    size_t groups = (max_bits + w - 1) / w;
+    storage.assign(groups * digits * k, 0);
+
+    // base_i = g^(2^(w*i)); hàng i là base_i, base_i^2, ..., base_i^(2^w - 1)
+    BigIntBinary base_i = ctx.to_mont(g), cur, next;
+    for (size_t i = 0; i < groups; ++i) {
+        cur = base_i;
+        for (size_t d = 1; d <= digits; ++d) {
+            if (d > 1) {
+                ctx.mul(cur, base_i, next);
+                cur.swap(next);
+            }
+            std::copy(cur.limbs.begin(), cur.limbs.end(), storage.begin() + (i * digits + d - 1) * k);
+        }
+        // base_(i+1) = base_i^(2^w) = base_i^(2^w - 1) * base_i
+        base_i = ctx.mul(cur, base_i);
+    }
+}
+
+FixedBaseExp::FixedBaseExp(const GroupTableFile& file)
+    : ctx(from_limbs(file.modulus(), file.header().k), (limb_t)file.header().n0_inv,
+          from_limbs(file.r2(), file.header().k), from_limbs(file.one(), file.header().k)),
+      g(from_limbs(file.generator(), file.header().k)),
+      w((int)file.header().window), max_bits((int)file.header().max_bits), mapped(file.table()) {
+    if (ctx.size() != file.header().k || entry_count() != file.header().entries) {
+        throw std::runtime_error("Group table file is inconsistent");
+    }
+}
+
+BigIntBinary FixedBaseExp::from_limbs(const limb_t* data, size_t k) {
+    BigIntBinary x;
+    x.limbs.assign(data, data + k);
+    x.normalize();
+    return x;
+}
+
+size_t FixedBaseExp::entry_count() const {
+    return (size_t)((max_bits + w - 1) / w) * ((1u << w) - 1);
+}
+
+BigIntBinary FixedBaseExp::pow(const BigIntBinary& e) const {
+    int bits = e.num_bits();
+    if (bits > max_bits) {
+        return ctx.pow(g, e);
+    }
+
+    size_t digits = (1u << w) - 1;
+    BigIntBinary res = ctx.mont_one(), tmp;
+    bool started = false;
+    for (int i = 0; i * w < bits; ++i) {
+        // Nhóm bit thứ i của số mũ
+        size_t d = (size_t)e.get_bits(i * w, w);
+        if (d == 0) continue;
+
+        const limb_t* t = entry(i * digits + d - 1);
+        if (started) {
+            ctx.mul(res, t, tmp);
+            res.swap(tmp);
+        }
+        else {
+            res.limbs.assign(t, t + ctx.size());
+            res.normalize();
+            started = true;
+        }
+    }
+    return ctx.from_mont(res);
+}
+
+// Mọi nhóm bit đều nhân (d = 0 chọn số 1), mục của bảng chọn bằng mặt nạ trên cả hàng
+BigIntBinary FixedBaseExp::pow_ct(const BigIntBinary& e, int exp_bits) const {
+    // Chỉ rẽ nhánh theo giới hạn công khai: bảng không đủ nhóm bit thì dùng lũy thừa cơ số thay đổi
+    const size_t bits = exp_bits > 0 ? (size_t)exp_bits : (size_t)ctx.modulus().num_bits();
+    if (bits > (size_t)max_bits) {
+        return ctx.pow_ct(g, e, (int)bits);
+    }
+
+    const size_t k = ctx.size();
+    const size_t digits = ((size_t)1 << w) - 1;
+    const size_t groups = (bits + w - 1) / w;
+    const size_t exp_len = (bits + LIMB_BITS - 1) / LIMB_BITS;
+
+    std::vector<limb_t> buf(3 * k + exp_len + k + 2, 0);
+    limb_t* acc = buf.data();
+    limb_t* sel = acc + k;
+    limb_t* one = sel + k;
+    limb_t* exp = one + k;
+    limb_t* t = exp + exp_len;
+    load_secret_exponent(exp, exp_len, e.limbs.data(), e.limbs.size(), bits);
+    std::copy(ctx.one.limbs.begin(), ctx.one.limbs.end(), one);
+    std::copy(one, one + k, acc);
+
+    for (size_t i = 0; i < groups; ++i) {
+        size_t d = exponent_bits_at(exp, exp_len, i * w, w);
+        limb_t is_zero = ct_eq_mask(d, 0);
+        for (size_t j = 0; j < k; ++j) {
+            sel[j] = one[j] & is_zero;
+        }
+        ct_lookup_or(sel, entry(i * digits), digits, k, d - 1);
+        ctx.mul_ct(acc, acc, sel, t);
+    }
+
+    // Về dạng thường: nhân với 1 thô
+    std::fill(one, one + k, 0);
+    one[0] = 1;
+    ctx.mul_ct(acc, acc, one, t);
+    BigIntBinary result;
+    result.limbs.assign(acc, acc + k);
+    result.normalize();
+    return result;
+}
+
+void FixedBaseExp::save(const std::string& path) const {
+    const size_t k = ctx.size();
+
+    GroupTableHeader header = {};
+    std::copy_n("BIGDHGT1", 8, header.magic);
+    header.version = 1;
+    header.limb_bits = LIMB_BITS;
+    header.byte_order = 0x01020304;
+    header.window = (uint32_t)w;
+    header.max_bits = (uint32_t)max_bits;
+    header.k = k;
+    header.n0_inv = ctx.n0_inv;
+    header.entries = entry_count();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot create group table file");
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Các số đều ghi đủ k limb
+    std::vector<limb_t> padded(k);
+    for (const BigIntBinary* x : { &ctx.n, &ctx.r2, &ctx.one, &g }) {
+        std::fill(std::copy(x->limbs.begin(), x->limbs.end(), padded.begin()), padded.end(), 0);
+        out.write(reinterpret_cast<const char*>(padded.data()), k * sizeof(limb_t));
+    }
+    out.write(reinterpret_cast<const char*>(entry(0)), header.entries * k * sizeof(limb_t));
+    if (!out) {
+        throw std::runtime_error("Failed to write group table file");
+    }
+}
+
+// --- Ánh xạ file bảng nhóm ---
+GroupTableFile::GroupTableFile(const std::string& path) : base(nullptr), length(0) {
+#ifdef _WIN32
+    file_handle = nullptr;
+    mapping_handle = nullptr;
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open group table file");
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart < sizeof(GroupTableHeader)) {
+        CloseHandle(file);
+        throw std::runtime_error("Group table file is too small");
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Cannot map group table file");
+    }
+    file_handle = file;
+    mapping_handle = mapping;
+    length = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open group table file");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(GroupTableHeader)) {
+        close(fd);
+        throw std::runtime_error("Group table file is too small");
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // Vùng ánh xạ vẫn còn sau khi đóng fd
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("Cannot map group table file");
+    }
+    length = (size_t)st.st_size;
+#endif
+    base = static_cast<const unsigned char*>(view);
+
+    // File đến từ bên ngoài: mọi trường của header bị giới hạn theo độ dài file trước khi nhân,
+    // để (4 + entries) * k không thể tràn số và không mục nào nằm ngoài vùng ánh xạ
+    const GroupTableHeader& h = header();
+    const size_t payload = length - sizeof(GroupTableHeader);
+    const uint64_t avail = payload / sizeof(limb_t);
+    bool valid = std::equal(h.magic, h.magic + 8, "BIGDHGT1") && h.version == 1 &&
+        h.limb_bits == (uint32_t)LIMB_BITS && h.byte_order == 0x01020304 &&
+        payload % sizeof(limb_t) == 0 && h.k > 0 && h.k <= avail &&
+        h.window >= 1 && h.window <= 16 && h.max_bits > 0 && h.max_bits <= (uint32_t)INT_MAX;
+    if (valid) {
+        uint64_t entries = ((uint64_t)h.max_bits + h.window - 1) / h.window * ((1u << h.window) - 1);
+        uint64_t rows = avail / h.k; // Số mảng k limb vừa trong file
+        valid = h.entries == entries && rows >= 4 && entries <= rows - 4 && (4 + entries) * h.k == avail;
+    }
+    if (valid) {
+        // p lẻ, đủ k limb (limb cao khác 0) và n0_inv * p = -1 mod 2^LIMB_BITS
+        const limb_t* p = modulus();
+        valid = (p[0] & 1) != 0 && p[h.k - 1] != 0 && (limb_t)(p[0] * (limb_t)h.n0_inv) == (limb_t)~(limb_t)0;
+    }
+    if (!valid) {
+        unmap();
+        throw std::runtime_error("Invalid or incompatible group table file");
+    }
+}
+
+GroupTableFile::~GroupTableFile() {
+    unmap();
+}
+
+void GroupTableFile::unmap() {
+    if (!base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+#else
+    munmap(const_cast<unsigned char*>(base), length);
+#endif
+    base = nullptr;
+}
+
+bool check_group_table_file(const std::string& path) {
+    auto read_all = [&path]() {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    };
+    auto write_all = [&path](const std::vector<char>& data) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), (std::streamsize)data.size());
+    };
+    auto rejected = [&path](const char* name) {
+        try {
+            GroupTableFile file(path);
+        }
+        catch (const std::runtime_error&) {
+            std::cout << name << ": bi tu choi" << std::endl;
+            return true;
+        }
+        std::cout << name << ": KHONG bi tu choi" << std::endl;
+        return false;
+    };
+
+    // File hợp lệ: p = 2^127 - 1 (lẻ, 2 limb 64 bit hoặc 4 limb 32 bit), g = 3
+    BigIntBinary p = (BigIntBinary(1) << 127) - BigIntBinary(1);
+    BigIntBinary e = (BigIntBinary(1) << 100) + BigIntBinary(12345);
+    FixedBaseExp(BigIntBinary(3), p).save(path);
+    bool ok;
+    {
+        GroupTableFile file(path);
+        ok = FixedBaseExp(file).pow(e) == modular_exponentiation(BigIntBinary(3), e, p);
+    }
+    std::cout << "file hop le: " << (ok ? "dung" : "SAI") << std::endl;
+    const std::vector<char> good = read_all();
+    GroupTableHeader h;
+    std::memcpy(&h, good.data(), sizeof(h));
+
+    // Header bị cắt ngắn
+    write_all(std::vector<char>(good.begin(), good.begin() + sizeof(h) / 2));
+    ok = rejected("header bi cat") && ok;
+
+    // Thiếu limb cuối của bảng
+    write_all(std::vector<char>(good.begin(), good.end() - sizeof(limb_t)));
+    ok = rejected("bang bi cat") && ok;
+
+    // (4 + entries) * k * sizeof(limb_t) tràn size_t về đúng độ dài file nếu nhân không kiểm tra
+    GroupTableHeader bad = h;
+    bad.k = (uint64_t)1 << 41;
+    bad.window = 1;
+    bad.max_bits = (1u << 20) - 4;
+    bad.entries = bad.max_bits;
+    std::vector<char> data(sizeof(bad));
+    std::memcpy(data.data(), &bad, sizeof(bad));
+    write_all(data);
+    ok = rejected("header tran so") && ok;
+
+    // entries không khớp window / max_bits
+    data = good;
+    bad = h;
+    bad.entries += 1;
+    std::memcpy(data.data(), &bad, sizeof(bad));
+    write_all(data);
+    ok = rejected("entries sai") && ok;
+
+    // Modulo chẵn
+    data = good;
+    data[sizeof(h)] ^= 1;
+    write_all(data);
+    ok = rejected("modulo chan") && ok;
+
+    std::remove(path.c_str());
+    return ok;
+}
+
+BigIntBinary modular_exponentiation(BigIntBinary a, BigIntBinary b, BigIntBinary n) {
+    // Modulo lẻ: làm việc trong miền Montgomery, không có phép chia trong vòng lặp
+    if (n.is_odd() && n > BigIntBinary(1)) {
+        MontgomeryContext ctx(n);
+        if (a == BigIntBinary(2)) {
+            return ctx.pow_base2(b);
+        }
+        return ctx.pow(a, b);
+    }
+
+    // Modulo chẵn: rút gọn Barrett, chỉ chia một lần khi dựng ngữ cảnh
+    BarrettContext ctx(n);
+    return sliding_window_pow(a % ctx, b, BigIntBinary(1) % ctx,
+        [&ctx](const BigIntBinary& x, const BigIntBinary& y, BigIntBinary& out) { ctx.mul(x, y, out); },
+        [&ctx](const BigIntBinary& x, BigIntBinary& out) { ctx.sqr(x, out); });
+}
+
+BigIntBinary modular_exponentiation_ct(const BigIntBinary& a, const BigIntBinary& b, const BigIntBinary& n, int exp_bits) {
+    if (!n.is_odd() || n == BigIntBinary(1)) {
+        throw std::runtime_error("Constant-time exponentiation needs an odd modulus greater than 1");
+    }
+    return MontgomeryContext(n).pow_ct(a, b, exp_bits);
+}
+
+BigIntBinary multi_exponentiation(const std::vector<BigIntBinary>& bases, const std::vector<BigIntBinary>& exponents,
+                                  const BigIntBinary& n) {
+    if (bases.size() != exponents.size()) {
+        throw std::runtime_error("Base and exponent counts do not match");
+    }
+    if (n.is_odd() && n > BigIntBinary(1)) {
+        return MontgomeryContext(n).multi_pow(bases, exponents);
+    }
+
+    BarrettContext ctx(n);
+    std::vector<BigIntBinary> reduced;
+    reduced.reserve(bases.size());
+    for (const BigIntBinary& a : bases) {
+        reduced.push_back(a % ctx);
+    }
+    return interleaved_multi_pow(reduced, exponents, BigIntBinary(1) % ctx,
+        [&ctx](const BigIntBinary& x, const BigIntBinary& y, BigIntBinary& out) { ctx.mul(x, y, out); },
+        [&ctx](const BigIntBinary& x, BigIntBinary& out) { ctx.sqr(x, out); });
+}
+
+// --- Ước chung lớn nhất và nghịch đảo modulo ---
+// Số nguyên có dấu cho hệ số Bézout: neg ? -mag : mag
+struct SignedBigInt {
+    BigIntBinary mag;
+    bool neg;
+};
+
+static SignedBigInt signed_add(BigIntBinary x, bool x_neg, BigIntBinary y, bool y_neg) {
+    if (x_neg == y_neg || y <= x) {
+        if (x_neg == y_neg) x += y;
+        else x -= y;
+        bool neg = x_neg && !x.is_zero();
+        return { std::move(x), neg };
+    }
+    y -= x;
+    return { std::move(y), y_neg };
+}
+
+// u * x + v * y với u, v là hệ số Lehmer (|u|, |v| < 2^60)
+static SignedBigInt signed_combine(int64_t u, const SignedBigInt& x, int64_t v, const SignedBigInt& y) {
+    BigIntBinary ux = BigIntBinary((unsigned long long)(u < 0 ? -u : u)) * x.mag;
+    BigIntBinary vy = BigIntBinary((unsigned long long)(v < 0 ? -v : v)) * y.mag;
+    return signed_add(std::move(ux), (u < 0) != x.neg, std::move(vy), (v < 0) != y.neg);
+}
+
+// Độ rộng cửa sổ bit đầu cho bước Lehmer: mọi đại lượng trung gian (|q * C| <= 2^61) vừa int64_t
+const int LEHMER_BITS = 60;
+
+// Đưa (a, b) về (gcd, 0). cofactor != nullptr: giữ s0, s1 với a = s0 * a_gốc (mod b_gốc), b = s1 * a_gốc (mod b_gốc)
+static void lehmer_gcd(BigIntBinary& a, BigIntBinary& b, SignedBigInt* s0, SignedBigInt* s1) {
+    BigIntBinary q, r;
+    while (!b.is_zero()) {
+        int shift = std::max(0, a.num_bits() - LEHMER_BITS);
+        int64_t ah = (int64_t)a.get_bits(shift, LEHMER_BITS);
+        int64_t bh = (int64_t)b.get_bits(shift, LEHMER_BITS);
+
+        // Euclid trên bit đầu (Knuth, thuật toán L): chỉ nhận thương khi hai cận trên/dưới cho cùng một giá trị
+        int64_t A = 1, B = 0, C = 0, D = 1;
+        while (bh + C != 0 && bh + D != 0) {
+            int64_t q1 = (ah + A) / (bh + C);
+            if (q1 != (ah + B) / (bh + D)) break;
+            int64_t t = A - q1 * C; A = C; C = t;
+            t = B - q1 * D; B = D; D = t;
+            t = ah - q1 * bh; ah = bh; bh = t;
+        }
+
+        if (B == 0) {
+            // Thương đầu tiên không vừa một từ máy: một bước chia đầy đủ
+            a.divide(b, q, r);
+            a.swap(b);
+            b.swap(r);
+            if (s0) {
+                SignedBigInt next = signed_add(s0->mag, s0->neg, q * s1->mag, !s1->neg);
+                std::swap(*s0, *s1);
+                *s1 = std::move(next);
+            }
+            continue;
+        }
+
+        SignedBigInt pa = { a, false }, pb = { b, false };
+        a = signed_combine(A, pa, B, pb).mag;
+        b = signed_combine(C, pa, D, pb).mag;
+        if (s0) {
+            SignedBigInt n0 = signed_combine(A, *s0, B, *s1);
+            SignedBigInt n1 = signed_combine(C, *s0, D, *s1);
+            *s0 = std::move(n0);
+            *s1 = std::move(n1);
+        }
+    }
+}
+
+BigIntBinary gcd(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary x = a, y = b;
+    if (x < y) x.swap(y);
+    lehmer_gcd(x, y, nullptr, nullptr);
+    return x;
+}
+
+ExtendedGcd extended_gcd(const BigIntBinary& a, const BigIntBinary& b) {
+    BigIntBinary x = a, y = b;
+    SignedBigInt s0 = { BigIntBinary(1), false }, s1 = { BigIntBinary(0), false };
+    if (x < y) {
+        x.swap(y);
+        std::swap(s0, s1);
+    }
+    lehmer_gcd(x, y, &s0, &s1);
+
+    ExtendedGcd result;
+    result.g = x;
+    result.x = s0.mag;
+    result.x_negative = s0.neg;
+    if (b.is_zero()) {
+        result.y = BigIntBinary(0);
+        result.y_negative = false;
+    }
+    else {
+        // y = (g - x * a) / b, phép chia chính xác
+        SignedBigInt rest = signed_add(x, false, s0.mag * a, !s0.neg);
+        result.y = rest.mag / b;
+        result.y_negative = rest.neg;
+    }
+    return result;
+}
+
+BigIntBinary mod_inverse(const BigIntBinary& a, const BigIntBinary& m) {
+    if (m.is_zero()) {
+        throw std::runtime_error("Modulus must be non-zero");
+    }
+    BigIntBinary x = a < m ? a : a % m;
+    BigIntBinary y = m;
+    SignedBigInt s0 = { BigIntBinary(1), false }, s1 = { BigIntBinary(0), false };
+    // x < m: đổi chỗ để lehmer_gcd nhận số lớn hơn trước
+    x.swap(y);
+    std::swap(s0, s1);
+    lehmer_gcd(x, y, &s0, &s1);
+    if (!(x == BigIntBinary(1))) {
+        throw std::runtime_error("Value is not invertible modulo m");
+    }
+    BigIntBinary inv = s0.mag % m;
+    return s0.neg && !inv.is_zero() ? m - inv : inv;
+}
+
+// r = x - y trên k limb, trả về borrow (0 hoặc 1)
+static limb_t ct_sub_limbs(limb_t* r, const limb_t* x, const limb_t* y, size_t k) {
+    limb_t borrow = 0;
+    for (size_t j = 0; j < k; ++j) {
+        dlimb_t diff = (dlimb_t)x[j] - y[j] - borrow;
+        r[j] = (limb_t)diff;
+        borrow = (limb_t)(diff >> (2 * LIMB_BITS - 1));
+    }
+    return borrow;
+}
+
+// r += y & mask trên k limb, trả về carry
+static limb_t ct_add_masked(limb_t* r, const limb_t* y, size_t k, limb_t mask) {
+    limb_t carry = 0;
+    for (size_t j = 0; j < k; ++j) {
+        dlimb_t sum = (dlimb_t)r[j] + (y[j] & mask) + carry;
+        r[j] = (limb_t)sum;
+        carry = (limb_t)(sum >> LIMB_BITS);
+    }
+    return carry;
+}
+
+// Dịch phải 1 bit, top là bit đưa vào vị trí cao nhất
+static void ct_shift_right_1(limb_t* r, size_t k, limb_t top) {
+    for (size_t j = 0; j + 1 < k; ++j) {
+        r[j] = (r[j] >> 1) | (r[j + 1] << (LIMB_BITS - 1));
+    }
+    r[k - 1] = (r[k - 1] >> 1) | (top << (LIMB_BITS - 1));
+}
+
+static void ct_select(limb_t* r, const limb_t* x, size_t k, limb_t mask) {
+    for (size_t j = 0; j < k; ++j) {
+        r[j] = (r[j] & ~mask) | (x[j] & mask);
+    }
+}
+
+static void ct_swap(limb_t* x, limb_t* y, size_t k, limb_t mask) {
+    for (size_t j = 0; j < k; ++j) {
+        limb_t d = (x[j] ^ y[j]) & mask;
+        x[j] ^= d;
+        y[j] ^= d;
+    }
+}
+
+// Bất biến x1 * a = u, x2 * a = v (mod m), v luôn lẻ. Mỗi bước làm tổng số bit của u, v giảm ít nhất 1
+// nên sau 2 * k * LIMB_BITS bước u = 0 và v = gcd(a, m).
+BigIntBinary mod_inverse_ct(const BigIntBinary& a, const BigIntBinary& m) {
+    if (!m.is_odd()) {
+        throw std::runtime_error("Constant-time inverse needs an odd modulus");
+    }
+    size_t k = m.limbs.size();
+    BigIntBinary reduced = a < m ? a : a % m;
+
+    std::vector<limb_t> buf(5 * k, 0);
+    limb_t* u = buf.data();
+    limb_t* v = u + k;
+    limb_t* x1 = v + k;
+    limb_t* x2 = x1 + k;
+    limb_t* t = x2 + k;
+    const limb_t* n = m.limbs.data();
+    std::copy(reduced.limbs.begin(), reduced.limbs.end(), u);
+    std::copy(n, n + k, v);
+    x1[0] = 1;
+
+    for (size_t i = 0; i < 2 * k * LIMB_BITS; ++i) {
+        limb_t odd = (limb_t)0 - (u[0] & 1);
+        // u lẻ và u < v: đổi (u, x1) với (v, x2)
+        limb_t swap = odd & ((limb_t)0 - ct_sub_limbs(t, u, v, k));
+        ct_swap(u, v, k, swap);
+        ct_swap(x1, x2, k, swap);
+        // u lẻ: u -= v, x1 = x1 - x2 mod m
+        ct_sub_limbs(t, u, v, k);
+        ct_select(u, t, k, odd);
+        limb_t borrow = ct_sub_limbs(t, x1, x2, k);
+        ct_add_masked(t, n, k, (limb_t)0 - borrow);
+        ct_select(x1, t, k, odd);
+        // u chẵn: u /= 2, x1 = x1 / 2 mod m
+        ct_shift_right_1(u, k, 0);
+        limb_t carry = ct_add_masked(x1, n, k, (limb_t)0 - (x1[0] & 1));
+        ct_shift_right_1(x1, k, carry);
+    }
+
+    limb_t not_one = v[0] ^ 1;
+    for (size_t j = 1; j < k; ++j) {
+        not_one |= v[j];
+    }
+    if (not_one != 0) {
+        throw std::runtime_error("Value is not invertible modulo m");
+    }
+    BigIntBinary inv;
+    inv.limbs.assign(x2, x2 + k);
+    inv.normalize();
+    std::fill(buf.begin(), buf.end(), 0);
+    return inv;
+}
+
+// --- Kiểm tra khóa công khai ---
+int jacobi_symbol(const BigIntBinary& a, const BigIntBinary& n) {
+    if (!n.is_odd()) {
+        throw std::runtime_error("Jacobi symbol needs an odd modulus");
+    }
+    BigIntBinary x = a < n ? a : a % n;
+    BigIntBinary y = n, q, r;
+    int t = 1;
+    while (!x.is_zero()) {
+        // Bỏ thừa số 2: (2/y) = -1 khi y ≡ 3, 5 (mod 8)
+        int s = 0;
+        while (!x.get_bit(s)) s++;
+        x >>= s;
+        uint64_t y8 = y.get_bits(0, 3);
+        if ((s & 1) && (y8 == 3 || y8 == 5)) t = -t;
+        // Luật tương hỗ bậc hai: đổi dấu khi x ≡ y ≡ 3 (mod 4), rồi (x, y) = (y mod x, x)
+        if (x.get_bits(0, 2) == 3 && (y8 & 3) == 3) t = -t;
+        y.divide(x, q, r);
+        y.swap(x);
+        x.swap(r);
+    }
+    return y == BigIntBinary(1) ? t : 0;
+}
+
+bool validate_public_key(const BigIntBinary& y, const BigIntBinary& p) {
+    if (!(BigIntBinary(1) < y) || !(y < p - BigIntBinary(1))) {
+        return false;
+    }
+    return jacobi_symbol(y, p) == 1;
+}
+
+bool validate_public_keys(const std::vector<BigIntBinary>& keys, const BigIntBinary& p, const BigIntBinary& q,
+                          int security_bits) {
+    // Nhóm con bậc q lẻ nằm trong tập thặng dư bậc hai: Jacobi loại ngay thành phần bậc 2
+    for (const BigIntBinary& y : keys) {
+        if (!validate_public_key(y, p)) {
+            return false;
+        }
+    }
+    if (keys.empty() || (q << 1) + BigIntBinary(1) == p) {
+        return true;
+    }
+
+    std::vector<BigIntBinary> weights(keys.size());
+    for (BigIntBinary& r : weights) {
+        do {
+            r = BigIntBinary::random_bits(security_bits);
+        } while (r.is_zero());
+    }
+    BigIntBinary combined = multi_exponentiation(keys, weights, p);
+    return modular_exponentiation(combined, q, p) == BigIntBinary(1);
+}
+
+// --- Nguồn số ngẫu nhiên ---
+void os_random_bytes(uint8_t* out, size_t len) {
+#ifdef _WIN32
+    if (BCryptGenRandom(nullptr, out, (ULONG)len, BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0) {
+        throw std::runtime_error("BCryptGenRandom failed");
+    }
+#elif defined(__linux__)
+    while (len > 0) {
+        ssize_t got = getrandom(out, len, 0);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("getrandom failed");
+        }
+        out += got;
+        len -= (size_t)got;
+    }
+#else
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open /dev/urandom");
+    }
+    while (len > 0) {
+        ssize_t got = read(fd, out, len);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR) continue;
+            close(fd);
+            throw std::runtime_error("Cannot read /dev/urandom");
+        }
+        out += got;
+        len -= (size_t)got;
+    }
+    close(fd);
+#endif
+}
+
+void SystemRandom::fill(uint8_t* out, size_t len) {
+    os_random_bytes(out, len);
+}
+
+static inline uint32_t rotl32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline void chacha_quarter_round(uint32_t* x, int a, int b, int c, int d) {
+    x[a] += x[b]; x[d] = rotl32(x[d] ^ x[a], 16);
+    x[c] += x[d]; x[b] = rotl32(x[b] ^ x[c], 12);
+    x[a] += x[b]; x[d] = rotl32(x[d] ^ x[a], 8);
+    x[c] += x[d]; x[b] = rotl32(x[b] ^ x[c], 7);
+}
+
+static inline uint32_t load_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Hàm khối ChaCha20 (RFC 8439): 64 byte đầu ra cho (khóa, bộ đếm, nonce)
+static void chacha20_block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], uint8_t out[64]) {
+    uint32_t state[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        counter, nonce[0], nonce[1], nonce[2]
+    };
+    uint32_t x[16];
+    std::copy(state, state + 16, x);
+    for (int i = 0; i < 10; ++i) {
+        chacha_quarter_round(x, 0, 4, 8, 12);
+        chacha_quarter_round(x, 1, 5, 9, 13);
+        chacha_quarter_round(x, 2, 6, 10, 14);
+        chacha_quarter_round(x, 3, 7, 11, 15);
+        chacha_quarter_round(x, 0, 5, 10, 15);
+        chacha_quarter_round(x, 1, 6, 11, 12);
+        chacha_quarter_round(x, 2, 7, 8, 13);
+        chacha_quarter_round(x, 3, 4, 9, 14);
+    }
+    for (int i = 0; i < 16; ++i) {
+        uint32_t v = x[i] + state[i];
+        out[4 * i] = (uint8_t)v;
+        out[4 * i + 1] = (uint8_t)(v >> 8);
+        out[4 * i + 2] = (uint8_t)(v >> 16);
+        out[4 * i + 3] = (uint8_t)(v >> 24);
+    }
+}
+
+// Tăng sau mỗi fork() để tiến trình con không lặp lại dòng byte của tiến trình cha
+static std::atomic<unsigned> fork_generation(0);
+
+void ChaCha20Random::fill(uint8_t* out, size_t len) {
+    struct State {
+        uint32_t key[8];
+        uint8_t buffer[RANDOM_BUFFER_BYTES];
+        size_t pos = RANDOM_BUFFER_BYTES; // Bộ đệm rỗng
+        uint64_t since_seed = 0;
+        unsigned generation = 0;
+        bool seeded = false;
+    };
+    thread_local State st;
+
+#ifndef _WIN32
+    static std::once_flag atfork_once;
+    std::call_once(atfork_once, [] {
+        pthread_atfork(nullptr, nullptr, [] { fork_generation.fetch_add(1, std::memory_order_relaxed); });
+    });
+#endif
+
+    unsigned generation = fork_generation.load(std::memory_order_relaxed);
+    if (st.generation != generation) {
+        st.pos = RANDOM_BUFFER_BYTES; // Bỏ phần byte còn lại dùng chung với tiến trình cha
+    }
+    while (len > 0) {
+        if (st.pos == RANDOM_BUFFER_BYTES) {
+            if (!st.seeded || st.since_seed >= RANDOM_RESEED_BYTES || st.generation != generation) {
+                uint8_t seed[32];
+                os_random_bytes(seed, sizeof(seed));
+                for (int i = 0; i < 8; ++i) {
+                    st.key[i] ^= load_le32(seed + 4 * i);
+                }
+                std::fill(seed, seed + sizeof(seed), 0);
+                st.seeded = true;
+                st.since_seed = 0;
+                st.generation = generation;
+            }
+
+            // Mỗi lô dùng khóa mới nên nonce cố định, bộ đếm bắt đầu từ 0
+            const uint32_t nonce[3] = { 0, 0, 0 };
+            for (size_t b = 0; b < RANDOM_BUFFER_BYTES / 64; ++b) {
+                chacha20_block(st.key, (uint32_t)b, nonce, st.buffer + 64 * b);
+            }
+            for (int i = 0; i < 8; ++i) {
+                st.key[i] = load_le32(st.buffer + 4 * i);
+            }
+            std::fill(st.buffer, st.buffer + 32, 0);
+            st.pos = 32;
+            st.since_seed += RANDOM_BUFFER_BYTES;
+        }
+
+        // Byte đã trả ra bị xóa khỏi bộ đệm
+        size_t take = std::min(len, RANDOM_BUFFER_BYTES - st.pos);
+        std::copy(st.buffer + st.pos, st.buffer + st.pos + take, out);
+        std::fill(st.buffer + st.pos, st.buffer + st.pos + take, 0);
+        st.pos += take;
+        out += take;
+        len -= take;
+    }
+}
+
+static std::atomic<RandomSource*> current_random_source(nullptr);
+
+RandomSource& random_source() {
+    static ChaCha20Random default_source;
+    RandomSource* source = current_random_source.load(std::memory_order_acquire);
+    return source ? *source : default_source;
+}
+
+void set_random_source(RandomSource* source) {
+    current_random_source.store(source, std::memory_order_release);
+}
+
+BigIntBinary BigIntBinary::random_bits(int bits) {
+    BigIntBinary x;
+    if (bits <= 0) {
+        return x;
+    }
+    size_t n = ((size_t)bits + LIMB_BITS - 1) / LIMB_BITS;
+    x.limbs.resize(n);
+    random_source().fill(reinterpret_cast<uint8_t*>(x.limbs.data()), n * sizeof(limb_t));
+    x.limbs[n - 1] &= ~(limb_t)0 >> (n * LIMB_BITS - bits);
+    x.normalize();
+    return x;
+}
+
+// Rút đủ số bit của giới hạn trên rồi so sánh; giới hạn có bit cao nhất bằng 1 nên mỗi lần thử
+// được nhận với xác suất > 1/2 (khóa ngắn: gần như luôn được nhận)
+BigIntBinary generate_private_key(const BigIntBinary& p, int exponent_bits) {
+    const BigIntBinary min(2);
+    const BigIntBinary max = p - min;
+    int bits = max.num_bits();
+
+    // Xử lý trường hợp p quá nhỏ (ví dụ p=3, phạm vi [2, 1] là không hợp lệ)
+    if (bits < 2) {
+        throw std::runtime_error("So nguyen to p qua nho de tao khoa rieng.");
+    }
+
+    // Khóa ngắn: [2, 2^exponent_bits) luôn nằm dưới p - 2 nên chỉ cần loại k < 2 (exponent_bits < 2: đủ khoảng)
+    bool short_key = exponent_bits >= 2 && exponent_bits < bits;
+    if (short_key) {
+        bits = exponent_bits;
+    }
+
+    BigIntBinary k;
+    do {
+        k = BigIntBinary::random_bits(bits);
+    } while (k < min || (!short_key && k > max));
+    return k;
+}
+
+
+// --- Sinh số nguyên tố an toàn ---
+
+// Các số nguyên tố nhỏ hơn 2^16, dùng cho chia thử và sàng ứng viên (tính một lần)
+static const std::vector<uint32_t>& small_primes() {
+    static const std::vector<uint32_t> primes = [] {
+        const uint32_t limit = 1 << 16;
+        std::vector<char> composite(limit, 0);
+        std::vector<uint32_t> result;
+        for (uint32_t i = 2; i < limit; ++i) {
+            if (composite[i]) continue;
+            result.push_back(i);
+            for (uint32_t j = i * i; j < limit; j += i) composite[j] = 1;
+        }
+        return result;
+    }();
+    return primes;
+}
+
+// a^(-1) mod m với m nguyên tố nhỏ, gcd(a, m) = 1 (Euclid mở rộng)
+static uint32_t inverse_mod_small(uint32_t a, uint32_t m) {
+    int64_t t = 0, new_t = 1;
+    int64_t r = m, new_r = a % m;
+    while (new_r != 0) {
+        int64_t q = r / new_r;
+        int64_t tmp = t - q * new_t; t = new_t; new_t = tmp;
+        tmp = r - q * new_r; r = new_r; new_r = tmp;
+    }
+    return (uint32_t)(t < 0 ? t + m : t);
+}
+
+// Số ngẫu nhiên đúng 'bits' bit (bit cao nhất bằng 1)
+static BigIntBinary random_with_bits(int bits) {
+    BigIntBinary x = BigIntBinary::random_bits(bits - 1);
+    x.set_bit(bits - 1);
+    return x;
+}
+
+// Số lần Miller-Rabin với cơ số ngẫu nhiên cho ứng viên ngẫu nhiên (xác suất sai < 2^-100)
+static int miller_rabin_rounds(int bits) {
+    if (bits >= 2048) return 4;
+    if (bits >= 1024) return 6;
+    if (bits >= 512) return 8;
+    return 20;
+}
+
+// Kiểm tra Miller-Rabin: chia thử cho các số nguyên tố nhỏ, rồi 'rounds' cơ số ngẫu nhiên
+bool is_probable_prime(const BigIntBinary& n, int rounds) {
+    if (n < BigIntBinary(2)) return false;
+
+    for (uint32_t sp : small_primes()) {
+        if (n.mod_int(sp) == 0) return n == BigIntBinary(sp);
+    }
+
+    // n - 1 = d * 2^s với d lẻ
+    BigIntBinary n_minus_1 = n - BigIntBinary(1);
+    int s = 0;
+    while (!n_minus_1.get_bit(s)) {
+        s++;
+    }
+    BigIntBinary d = n_minus_1 >> s;
+
+    MontgomeryContext ctx(n);
+    const BigIntBinary& one_m = ctx.mont_one();
+    BigIntBinary minus_one_m = n - one_m; // -1 ở dạng Montgomery
+    BigIntBinary x, tmp;
+
+    for (int round = 0; round < rounds; ++round) {
+        // Cơ số ngẫu nhiên trong [2, n - 2]
+        x = ctx.to_mont(ctx.pow(generate_private_key(n), d));
+        if (x == one_m || x == minus_one_m) continue;
+
+        bool witness = true;
+        for (int i = 1; i < s; ++i) {
+            ctx.sqr(x, tmp);
+            x.swap(tmp);
+            if (x == minus_one_m) {
+                witness = false;
+                break;
+            }
+            if (x == one_m) break;
+        }
+        if (witness) return false;
+    }
+    return true;
+}
+
+// Tìm số nguyên tố an toàn p = 2q + 1 (q nguyên tố) có đúng bit_size bit.
+// Chọn q ≡ 11 (mod 12): q lẻ, q và p không chia hết cho 3, và p ≡ 23 (mod 24). Điều kiện
+// p ≡ 7 (mod 8) là điều làm 2 thành thặng dư bậc hai, tức g = 2 sinh nhóm con cấp q; validate_public_key
+// dựa vào đó nên không được bỏ ràng buộc này. Hệ quả: không có p nào 7 bit (chỉ có 83 và 107, đều
+// ≡ 3 mod 8), nên generate_safe_prime yêu cầu từ 8 bit. Mỗi cửa sổ gồm các ứng viên q0 + 12k được sàng cùng lúc cho cả q và 2q + 1
+// bằng các số nguyên tố nhỏ; ứng viên sống sót qua phép thử Fermat cơ số 2 (rẻ) trên q và p
+// rồi mới chạy Miller-Rabin đầy đủ.
+// Mỗi luồng gọi hàm này với điểm bắt đầu lấy từ RNG riêng của luồng; trả về false khi stop
+// được bật (luồng khác đã tìm thấy).
+static bool search_safe_prime(int bit_size, const std::atomic<bool>& stop, BigIntBinary& p) {
+    const BigIntBinary one(1);
+    const int q_bits = bit_size - 1;
+    const int rounds = miller_rabin_rounds(bit_size);
+
+    // Kiểm tra một ứng viên q đã qua sàng
+    auto accept = [&](const BigIntBinary& q) {
+        if (!(MontgomeryContext(q).pow_base2(q - one) == one)) return false;
+        p = q + q + one;
+        if (!(MontgomeryContext(p).pow_base2(p - one) == one)) return false;
+        return is_probable_prime(q, rounds) && is_probable_prime(p, rounds);
+    };
+
+    // Ứng viên ngẫu nhiên q0 có q_bits bit, q0 ≡ 11 (mod 12)
+    auto random_start = [&]() {
+        BigIntBinary q0 = random_with_bits(q_bits);
+        q0 -= BigIntBinary(q0.mod_int(12));
+        q0 += BigIntBinary(11);
+        return q0;
+    };
+
+    // Số nhỏ: các số nguyên tố nhỏ có thể chính là q hoặc p nên không sàng
+    if (bit_size <= 32) {
+        while (!stop.load(std::memory_order_relaxed)) {
+            BigIntBinary q = random_start();
+            if (q.num_bits() != q_bits) continue;
+            if (is_probable_prime(q, rounds) && is_probable_prime(q + q + one, rounds)) {
+                p = q + q + one;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<uint32_t>& primes = small_primes();
+
+    // 12^(-1) mod sp cho từng số nguyên tố sàng (bỏ 2 và 3 vì đã loại bằng q ≡ 11 mod 12)
+    static const std::vector<uint32_t> inv12 = [&primes] {
+        std::vector<uint32_t> inv(primes.size(), 0);
+        for (size_t i = 2; i < primes.size(); ++i) inv[i] = inverse_mod_small(12, primes[i]);
+        return inv;
+    }();
+
+    const uint32_t window = 1 << 16;
+    const BigIntBinary window_step(12ULL * window);
+    std::vector<char> composite(window);
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        BigIntBinary base = random_start();
+
+        // Trượt cửa sổ cho tới khi ứng viên vượt quá q_bits bit thì chọn điểm bắt đầu mới
+        while ((base + window_step).num_bits() == q_bits) {
+            std::fill(composite.begin(), composite.end(), 0);
+
+            for (size_t i = 2; i < primes.size(); ++i) {
+                uint64_t sp = primes[i];
+                uint64_t r = base.mod_int(primes[i]);
+                // q = base + 12k chia hết cho sp  <=>  k ≡ -r / 12 (mod sp)
+                uint64_t k0 = (sp - r) % sp * inv12[i] % sp;
+                // 2q + 1 chia hết cho sp  <=>  q ≡ (sp - 1) / 2 (mod sp)
+                uint64_t k1 = ((sp - 1) / 2 + sp - r) % sp * inv12[i] % sp;
+                for (uint64_t k = k0; k < window; k += sp) composite[k] = 1;
+                for (uint64_t k = k1; k < window; k += sp) composite[k] = 1;
+            }
+
+            for (uint32_t k = 0; k < window; ++k) {
+                if (composite[k]) continue;
+                if (stop.load(std::memory_order_relaxed)) return false;
+                if (accept(base + BigIntBinary(12ULL * k))) return true;
+            }
+
+            base += window_step;
+        }
+    }
+    return false;
+}
+
+// Sinh số nguyên tố an toàn có đúng bit_size bit, tìm song song trên num_threads luồng
+// (0 = số lõi của máy). Luồng đầu tiên tìm thấy bật cờ dừng, các luồng còn lại thoát ở ứng viên kế tiếp.
+BigIntBinary generate_safe_prime(int bit_size, unsigned num_threads) {
+    // Kích thước nhỏ nhất mà mọi kích thước từ đó trở lên đều có p ≡ 23 (mod 24); 7 bit thì không có
+    if (bit_size < 8) {
+        throw std::invalid_argument("Safe prime bit size must be at least 8");
+    }
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::atomic<bool> stop(false);
+    BigIntBinary result;
+
+    // Số nhỏ tìm gần như tức thì, không đáng tạo luồng
+    if (num_threads == 1 || bit_size <= 32) {
+        search_safe_prime(bit_size, stop, result);
+        return result;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(num_threads);
+    for (unsigned t = 0; t < num_threads; ++t) {
+        workers.emplace_back([&] {
+            BigIntBinary p;
+            // Chỉ luồng bật cờ đầu tiên được ghi kết quả; join() đồng bộ kết quả về luồng gọi
+            if (search_safe_prime(bit_size, stop, p) && !stop.exchange(true)) {
+                result = std::move(p);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return result;
+}
+
+// --- Thread pool ---
+WorkStealingPool::WorkStealingPool(unsigned num_threads)
+    : count(num_threads), job(nullptr), generation(0), pending(0), shutdown(false) {
+    if (count == 0) {
+        count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    ranges.reset(new Range[count]);
+    threads.reserve(count - 1);
+    for (unsigned id = 1; id < count; ++id) {
+        threads.emplace_back(&WorkStealingPool::worker_loop, this, id);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        shutdown = true;
+    }
+    cv_start.notify_all();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+void WorkStealingPool::worker_loop(unsigned id) {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv_start.wait(lock, [&] { return shutdown || generation != seen; });
+            if (shutdown) return;
+            seen = generation;
+        }
+        run(id);
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (--pending == 0) cv_done.notify_one();
+        }
+    }
+}
+
+void WorkStealingPool::run(unsigned id) {
+    const std::function<void(size_t)>& f = *job;
+    size_t index;
+    while (take(id, index) || steal(id, index)) {
+        try {
+            f(index);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(m);
+            if (!error) error = std::current_exception();
+        }
+    }
+}
+
+// Lấy chỉ số kế tiếp trong đoạn của chính mình
+bool WorkStealingPool::take(unsigned id, size_t& index) {
+    Range& own = ranges[id];
+    std::lock_guard<std::mutex> lock(own.m);
+    if (own.begin == own.end) return false;
+    index = own.begin++;
+    return true;
+}
+
+// Lấy nửa sau đoạn còn lại của luồng khác: làm ngay phần tử đầu, phần còn lại thành đoạn của mình
+bool WorkStealingPool::steal(unsigned id, size_t& index) {
+    for (unsigned k = 1; k < count; ++k) {
+        Range& victim = ranges[(id + k) % count];
+        size_t from, to;
+        {
+            std::lock_guard<std::mutex> lock(victim.m);
+            size_t left = victim.end - victim.begin;
+            if (left == 0) continue;
+            to = victim.end;
+            from = to - (left + 1) / 2;
+            victim.end = from;
+        }
+        {
+            Range& own = ranges[id];
+            std::lock_guard<std::mutex> lock(own.m);
+            own.begin = from + 1;
+            own.end = to;
+        }
+        index = from;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::parallel_for(size_t n, const std::function<void(size_t)>& f) {
+    if (n == 0) return;
+
+    // Chia đều ban đầu, phần lệch về sau được cân bằng bằng cách lấy việc
+    for (unsigned id = 0; id < count; ++id) {
+        std::lock_guard<std::mutex> lock(ranges[id].m);
+        ranges[id].begin = n * id / count;
+        ranges[id].end = n * (id + 1) / count;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m);
+        job = &f;
+        error = nullptr;
+        pending = count - 1;
+        ++generation;
+    }
+    cv_start.notify_all();
+
+    run(0);
+
+    std::exception_ptr failed;
+    {
+        std::unique_lock<std::mutex> lock(m);
+        cv_done.wait(lock, [&] { return pending == 0; });
+        job = nullptr;
+        failed = error;
+        error = nullptr;
+    }
+    if (failed) {
+        std::rethrow_exception(failed);
+    }
+}
+
+// --- Diffie-Hellman theo lô ---
+DHBatchEngine::DHBatchEngine(const BigIntBinary& p, const BigIntBinary& g, unsigned num_threads)
+    : generator(g, p), pool(num_threads), constant_time(true), exponent_bits(0), validate_peers(true) {
+}
+
+DHBatchEngine::DHBatchEngine(const GroupTableFile& file, unsigned num_threads)
+    : generator(file), pool(num_threads), constant_time(true), exponent_bits(0), validate_peers(true) {
+}
+
+std::vector<BigIntBinary> DHBatchEngine::public_keys(const std::vector<BigIntBinary>& private_keys) {
+    std::vector<BigIntBinary> result(private_keys.size());
+    pool.parallel_for(private_keys.size(), [&](size_t i) {
+        result[i] = constant_time ? generator.pow_ct(private_keys[i], exponent_bits) : generator.pow(private_keys[i]);
+    });
+    return result;
+}
+
+std::vector<BigIntBinary> DHBatchEngine::shared_secrets(const std::vector<BigIntBinary>& peer_public_keys,
+                                                        const std::vector<BigIntBinary>& private_keys) {
+    if (peer_public_keys.size() != private_keys.size()) {
+        throw std::runtime_error("Batch key counts do not match");
+    }
+    const MontgomeryContext& ctx = generator.context();
+    std::vector<BigIntBinary> result(private_keys.size());
+    pool.parallel_for(private_keys.size(), [&](size_t i) {
+        if (validate_peers && !validate_public_key(peer_public_keys[i], ctx.modulus())) {
+            throw std::runtime_error("Invalid peer public key");
+        }
+        result[i] = constant_time ? ctx.pow_ct(peer_public_keys[i], private_keys[i], exponent_bits)
+                                  : ctx.pow(peer_public_keys[i], private_keys[i]);
+    });
+    return result;
+}
+
+std::vector<BigIntBinary> DHBatchEngine::shared_secrets(const std::vector<BigIntBinary>& peer_public_keys,
+                                                        const BigIntBinary& private_key) {
+    const MontgomeryContext& ctx = generator.context();
+    std::vector<BigIntBinary> result(peer_public_keys.size());
+    pool.parallel_for(peer_public_keys.size(), [&](size_t i) {
+        if (validate_peers && !validate_public_key(peer_public_keys[i], ctx.modulus())) {
+            throw std::runtime_error("Invalid peer public key");
+        }
+        result[i] = constant_time ? ctx.pow_ct(peer_public_keys[i], private_key, exponent_bits)
+                                  : ctx.pow(peer_public_keys[i], private_key);
+    });
+    return result;
+}
+
+// Đo số lần bắt tay mỗi giây theo số luồng 1, 2, 4, ..., max_threads (0 = số lõi của máy).
+// Một lần bắt tay là việc của một bên: tính khóa công khai g^x, kiểm tra y và tính bí mật chung y^x.
+void benchmark_dh_throughput(int bit_size, size_t handshakes, unsigned max_threads) {
+    if (max_threads == 0) {
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (handshakes == 0) {
+        throw std::runtime_error("Handshake count must be positive");
+    }
+
+    std::cout << "Generating " << bit_size << "-bit safe prime..." << std::endl;
+    BigIntBinary p = generate_safe_prime(bit_size, max_threads);
+    BigIntBinary g(2);
+
+    // Khóa riêng của hai bên, khóa công khai của đối phương và kết quả đúng để đối chiếu
+    struct KeySet {
+        std::vector<BigIntBinary> own, peer, peer_public, expected;
+    };
+    auto make_keys = [&](int exponent_bits) {
+        KeySet keys;
+        for (size_t i = 0; i < handshakes; ++i) {
+            keys.own.push_back(generate_private_key(p, exponent_bits));
+            keys.peer.push_back(generate_private_key(p, exponent_bits));
+        }
+        DHBatchEngine engine(p, g, max_threads);
+        keys.peer_public = engine.public_keys(keys.peer);
+        keys.expected = engine.shared_secrets(engine.public_keys(keys.own), keys.peer);
+        return keys;
+    };
+
+    std::vector<unsigned> thread_counts;
+    for (unsigned t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    // Mỗi số luồng đo các chế độ: thời gian hằng (mặc định), thời gian biến thiên,
+    // và với nhóm từ 2048 bit thêm thời gian hằng với khóa riêng SHORT_EXPONENT_BITS bit
+    struct Mode {
+        const char* name;
+        bool constant_time;
+        int exponent_bits;
+    };
+    std::vector<Mode> modes = { { "ct", true, 0 }, { "vartime", false, 0 } };
+    if (bit_size >= 2048) {
+        modes.push_back({ "ct-short", true, SHORT_EXPONENT_BITS });
+    }
+
+    KeySet full_keys = make_keys(0);
+    KeySet short_keys;
+    if (bit_size >= 2048) {
+        short_keys = make_keys(SHORT_EXPONENT_BITS);
+    }
+
+    for (const Mode& mode : modes) {
+        const KeySet& keys = mode.exponent_bits ? short_keys : full_keys;
+        double base_rate = 0;
+        for (unsigned t : thread_counts) {
+            DHBatchEngine engine(p, g, t);
+            engine.set_constant_time(mode.constant_time);
+            engine.set_exponent_bits(mode.exponent_bits);
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<BigIntBinary> own_public = engine.public_keys(keys.own);
+            std::vector<BigIntBinary> secrets = engine.shared_secrets(keys.peer_public, keys.own);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (secrets != keys.expected) {
+                throw std::runtime_error("Batch shared secrets do not match");
+            }
+
+            double rate = handshakes / seconds;
+            if (base_rate == 0) base_rate = rate;
+            std::cout << "mode=" << mode.name << " threads=" << t << " bits=" << bit_size
+                      << " handshakes=" << handshakes << " handshakes/s=" << rate
+                      << " speedup=" << rate / base_rate << std::endl;
+        }
+    }
 }
-*/
\ No newline at end of file
@@ -4,29 +4,288 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <cstdint> // Để dùng uint32_t và uint64_t
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#if defined(__has_include)
+#if __has_include(<span>) && (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L))
+#include <span>
+#define BIGINT_HAS_SPAN 1
+#endif
+#endif
+
+// --- Độ rộng limb ---
+// Mặc định dùng limb 64 bit với tích 128 bit khi trình biên dịch có unsigned __int128
+// (GCC/Clang trên x86-64, AArch64); -DBIGINT_LIMB32 hoặc MSVC thì dùng limb 32 bit.
+#if defined(__SIZEOF_INT128__) && !defined(BIGINT_LIMB32)
+typedef uint64_t limb_t;
+typedef unsigned __int128 dlimb_t;
+const int LIMB_BITS = 64;
+const int DECIMAL_CHUNK_DIGITS = 19;                  // Số chữ số thập phân lớn nhất vừa một limb
+const limb_t DECIMAL_CHUNK = 10000000000000000000ULL; // 10^DECIMAL_CHUNK_DIGITS
+#else
+typedef uint32_t limb_t;
+typedef uint64_t dlimb_t;
+const int LIMB_BITS = 32;
+const int DECIMAL_CHUNK_DIGITS = 9;
+const limb_t DECIMAL_CHUNK = 1000000000;
+#endif
+const limb_t LIMB_HIGH_BIT = (limb_t)1 << (LIMB_BITS - 1);
+const dlimb_t BASE = (dlimb_t)1 << LIMB_BITS;
+
+// Ngưỡng chuyển thuật toán nhân (tính theo số limb của toán hạng nhỏ hơn)
+// Có thể chỉnh lại cho máy hiện tại bằng: <chương trình> --tune-mul
+extern size_t KARATSUBA_THRESHOLD;
+extern size_t TOOM3_THRESHOLD;
+
+// Kernel nhân SIMD chọn lúc chạy theo CPUID (tắt khi biên dịch với -DBIGINT_NO_SIMD).
+// Ngưỡng riêng của từng kernel (số limb, chỉ số là MulKernel): trường hợp cơ sở dùng kernel từ 'mul' / 'sqr' limb,
+// Karatsuba bắt đầu từ 'karatsuba' thay cho KARATSUBA_THRESHOLD. --tune-mul dò lại cho kernel đang dùng.
+enum class MulKernel { Scalar, Avx2, Avx512Ifma };
+struct SimdThresholds {
+    size_t mul;
+    size_t sqr;
+    size_t karatsuba;
+};
+extern SimdThresholds SIMD_THRESHOLDS[3];
+
+// Từ ngưỡng này (số limb) chuyển đổi thập phân dùng chia để trị theo lũy thừa 10^(DECIMAL_CHUNK_DIGITS * 2^i)
+const size_t DECIMAL_DC_THRESHOLD = 40;
+
+// Số limb lưu ngay trong đối tượng (không cần heap). Mặc định đủ cho tích 2048 bit cùng REDC;
+// nhóm 3072/4096 bit nên đặt BIGINT_INLINE_LIMBS = (6208 / LIMB_BITS) hoặc (8256 / LIMB_BITS).
+#ifndef BIGINT_INLINE_LIMBS
+#define BIGINT_INLINE_LIMBS (4160 / LIMB_BITS)
+#endif
+
+
+// --- Bộ nhớ limb ---
+// Dùng như std::vector<limb_t>, nhưng N limb đầu nằm ngay trong đối tượng
+// và chỉ cấp phát heap khi số vượt quá N limb (vùng heap được giữ lại để dùng tiếp).
+template <size_t N>
+class LimbVector {
+private:
+    limb_t* ptr;
+    size_t count;
+    size_t cap;
+    limb_t inline_buf[N];
+
+    bool is_inline() const { return ptr == inline_buf; }
+    void grow(size_t need);
+
+public:
+    LimbVector() : ptr(inline_buf), count(0), cap(N) {}
+    LimbVector(size_t n, limb_t value) : LimbVector() { assign(n, value); }
+    LimbVector(const LimbVector& other);
+    LimbVector(LimbVector&& other) noexcept;
+    LimbVector& operator=(const LimbVector& other);
+    LimbVector& operator=(LimbVector&& other) noexcept;
+    ~LimbVector() { if (!is_inline()) delete[] ptr; }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return count == 0; }
+    limb_t* data() { return ptr; }
+    const limb_t* data() const { return ptr; }
+    limb_t* begin() { return ptr; }
+    limb_t* end() { return ptr + count; }
+    const limb_t* begin() const { return ptr; }
+    const limb_t* end() const { return ptr + count; }
+    limb_t& operator[](size_t i) { return ptr[i]; }
+    const limb_t& operator[](size_t i) const { return ptr[i]; }
+    limb_t& back() { return ptr[count - 1]; }
+    const limb_t& back() const { return ptr[count - 1]; }
+
+    void clear() { count = 0; }
+    void reserve(size_t n) { if (n > cap) grow(n); }
+    void resize(size_t n, limb_t value = 0);
+    void assign(size_t n, limb_t value);
+    void assign(const limb_t* first, const limb_t* last);
+    void push_back(limb_t value);
+    void pop_back() { count--; }
+    limb_t* erase(limb_t* first, limb_t* last);
+    void swap(LimbVector& other) noexcept;
+
+    friend bool operator==(const LimbVector& a, const LimbVector& b) {
+        return a.count == b.count && std::equal(a.begin(), a.end(), b.begin());
+    }
+};
+
+template <size_t N>
+void LimbVector<N>::grow(size_t need) {
+    size_t new_cap = std::max(need, 2 * cap);
+    limb_t* p = new limb_t[new_cap];
+    std::copy(ptr, ptr + count, p);
+    if (!is_inline()) delete[] ptr;
+    ptr = p;
+    cap = new_cap;
+}
+
+template <size_t N>
+LimbVector<N>::LimbVector(const LimbVector& other) : LimbVector() {
+    assign(other.begin(), other.end());
+}
+
+template <size_t N>
+LimbVector<N>::LimbVector(LimbVector&& other) noexcept : LimbVector() {
+    if (other.is_inline()) {
+        std::copy(other.begin(), other.end(), inline_buf);
+        count = other.count;
+    }
+    else {
+        // Lấy luôn vùng heap của other
+        ptr = other.ptr;
+        count = other.count;
+        cap = other.cap;
+        other.ptr = other.inline_buf;
+        other.cap = N;
+    }
+    other.count = 0;
+}
+
+template <size_t N>
+LimbVector<N>& LimbVector<N>::operator=(const LimbVector& other) {
+    if (this != &other) {
+        assign(other.begin(), other.end());
+    }
+    return *this;
+}
+
+template <size_t N>
+LimbVector<N>& LimbVector<N>::operator=(LimbVector&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    if (other.is_inline()) {
+        assign(other.begin(), other.end());
+    }
+    else {
+        if (!is_inline()) delete[] ptr;
+        ptr = other.ptr;
+        count = other.count;
+        cap = other.cap;
+        other.ptr = other.inline_buf;
+        other.cap = N;
+    }
+    other.count = 0;
+    return *this;
+}
+
+template <size_t N>
+void LimbVector<N>::resize(size_t n, limb_t value) {
+    if (n > cap) grow(n);
+    if (n > count) std::fill(ptr + count, ptr + n, value);
+    count = n;
+}
+
+template <size_t N>
+void LimbVector<N>::assign(size_t n, limb_t value) {
+    if (n > cap) grow(n);
+    std::fill(ptr, ptr + n, value);
+    count = n;
+}
+
+template <size_t N>
+void LimbVector<N>::assign(const limb_t* first, const limb_t* last) {
+    size_t n = last - first;
+    if (n > cap) {
+        count = 0;
+        grow(n);
+    }
+    std::copy(first, last, ptr);
+    count = n;
+}
+
+template <size_t N>
+void LimbVector<N>::push_back(limb_t value) {
+    if (count == cap) grow(count + 1);
+    ptr[count++] = value;
+}
+
+template <size_t N>
+limb_t* LimbVector<N>::erase(limb_t* first, limb_t* last) {
+    std::copy(last, end(), first);
+    count -= last - first;
+    return first;
+}
+
+template <size_t N>
+void LimbVector<N>::swap(LimbVector& other) noexcept {
+    if (!is_inline() && !other.is_inline()) {
+        std::swap(ptr, other.ptr);
+        std::swap(count, other.count);
+        std::swap(cap, other.cap);
+        return;
+    }
+    // Có ít nhất một bên dùng bộ nhớ trong đối tượng: phải chép dữ liệu
+    LimbVector tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+}
+
+typedef LimbVector<BIGINT_INLINE_LIMBS> Limbs;
+
 
 class BigIntBinary {
 private:
-    std::vector<uint32_t> limbs;
+    Limbs limbs;
 
     // Xóa các số 0 thừa ở đầu
     void normalize();
     void add_int(uint32_t n);
     void multiply_by_int(uint32_t n);
-    uint32_t divide_by_10_and_get_remainder();
+    uint32_t divide_by_int(uint32_t n);
+    void mul_add_limb(limb_t m, limb_t a); // *this = *this * m + a
+    limb_t divide_by_limb(limb_t d);        // *this /= d, trả về số dư
+
+    // --- Chuyển đổi thập phân ---
+    static const BigIntBinary& decimal_power(size_t i); // 10^(DECIMAL_CHUNK_DIGITS * 2^i), lưu đệm
+    static const BigIntBinary& decimal_reciprocal(size_t i); // floor(2^(2b) / decimal_power(i)), b = số bit, lưu đệm
+    static void write_decimal(const BigIntBinary& x, char* out, size_t digits); // Đúng 'digits' chữ số, đệm 0
+    static BigIntBinary parse_decimal(const char* s, size_t len);
+
+    // --- Nhân nhanh ---
+    BigIntBinary slice(size_t from, size_t to) const; // Các limb [from, to)
+    void add_shifted(const BigIntBinary& x, size_t offset); // *this += x * BASE^offset
+
+    // Kernel trên mảng limb thô: r ghi đủ n + m limb (2n khi bình phương),
+    // vùng nhớ tạm do hàm gọi cấp nên không cấp phát trong đệ quy
+    static limb_t add_limbs(limb_t* r, size_t rn, const limb_t* x, size_t xn); // r += x, trả về carry
+    static limb_t sub_limbs(limb_t* r, size_t rn, const limb_t* x, size_t xn); // r -= x, trả về borrow
+    static void mul_schoolbook_limbs(limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m);
+    static void mul_basecase_limbs(limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m); // Schoolbook hoặc SIMD
+    static void mul_karatsuba_limbs(limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m, limb_t* scratch);
+    static void mul_limbs(limb_t* r, const limb_t* a, size_t n, const limb_t* b, size_t m, limb_t* scratch);
+    static void sqr_schoolbook_limbs(limb_t* r, const limb_t* a, size_t n);
+    static void sqr_basecase_limbs(limb_t* r, const limb_t* a, size_t n);
+    static void sqr_karatsuba_limbs(limb_t* r, const limb_t* a, size_t n, limb_t* scratch);
+    static void sqr_limbs(limb_t* r, const limb_t* a, size_t n, limb_t* scratch);
+    static limb_t* scratch_buffer(size_t n); // Vùng nhớ tạm riêng cho mỗi luồng, chỉ lớn dần
+
+    static BigIntBinary mul_schoolbook(const BigIntBinary& a, const BigIntBinary& b);
+    static BigIntBinary mul_karatsuba(const BigIntBinary& a, const BigIntBinary& b);
+    static BigIntBinary mul_toom3(const BigIntBinary& a, const BigIntBinary& b);
+    static BigIntBinary sqr_toom3(const BigIntBinary& a);
 
 public:
     // --- Constructors ---
     BigIntBinary(unsigned long long n = 0);
     BigIntBinary(const std::string& s);
     BigIntBinary(const BigIntBinary& other); // Copy constructor
+    BigIntBinary(BigIntBinary&& other) noexcept; // Move constructor
 
     // --- Phép toán quan trọng ---
 
     void divide_by_2();
     bool is_odd() const;
     bool is_zero() const;
+    uint32_t mod_int(uint32_t n) const; // *this mod n, không thay đổi *this
+    static BigIntBinary random_bits(int bits); // Ngẫu nhiên đều trong [0, 2^bits): rút thẳng từng limb, chỉ che limb cao nhất
 
 
     // --- Phép so sánh ---
@@ -36,35 +295,69 @@ public:
     // --- In số ---
     friend std::ostream& operator<<(std::ostream& out, const BigIntBinary& a);
 
+    // --- Nhị phân big-endian và hex (O(n), đọc/ghi thẳng vào limbs) ---
+    static BigIntBinary from_bytes(const uint8_t* data, size_t len);
+    size_t byte_length() const;                          // Số byte tối thiểu để biểu diễn
+    void to_bytes(uint8_t* out, size_t len) const;       // Ghi đúng len byte, đệm 0 bên trái
+    std::vector<uint8_t> to_bytes(size_t len = 0) const; // len = 0: byte_length()
+    static BigIntBinary from_hex(const std::string& s);
+    std::string to_hex() const;                          // Chữ thường, không có số 0 ở đầu
+#ifdef BIGINT_HAS_SPAN
+    static BigIntBinary from_bytes(std::span<const uint8_t> data) { return from_bytes(data.data(), data.size()); }
+    void to_bytes(std::span<uint8_t> out) const { to_bytes(out.data(), out.size()); }
+#endif
+
 
     // --- Thao tác bit ---
+    // Dịch nhiều bit: phần nguyên limb dời bằng memmove, phần lẻ ghép từ hai limb kề nhau
+    BigIntBinary& operator<<=(size_t shift);
+    BigIntBinary& operator>>=(size_t shift);
+    friend BigIntBinary operator<<(const BigIntBinary& a, size_t shift);
+    friend BigIntBinary operator>>(const BigIntBinary& a, size_t shift);
+    BigIntBinary& operator&=(const BigIntBinary& other);
+    BigIntBinary& operator|=(const BigIntBinary& other);
+    BigIntBinary& operator^=(const BigIntBinary& other);
+    friend BigIntBinary operator&(const BigIntBinary& a, const BigIntBinary& b);
+    friend BigIntBinary operator|(const BigIntBinary& a, const BigIntBinary& b);
+    friend BigIntBinary operator^(const BigIntBinary& a, const BigIntBinary& b);
     void shift_left_1_bit();
-    int num_bits() const;
+    int num_bits() const; // Đếm bit 0 đầu của limb cao nhất bằng lệnh clz / bsr
     bool get_bit(int n) const;
+    uint64_t get_bits(int pos, int count) const; // count <= 64 bit bắt đầu từ bit pos (bit ngoài số là 0)
     void set_bit(int n);
 
     // --- Phép toán---
     // Phép gán
     BigIntBinary& operator=(const BigIntBinary& other);
+    BigIntBinary& operator=(BigIntBinary&& other) noexcept;
+    void swap(BigIntBinary& other) noexcept;
 
     // Phép cộng
     BigIntBinary& operator+=(const BigIntBinary& other);
     friend BigIntBinary operator+(const BigIntBinary& a, const BigIntBinary& b);
+    friend BigIntBinary operator+(BigIntBinary&& a, const BigIntBinary& b);
 
     // Phép trừ
     BigIntBinary& operator-=(const BigIntBinary& other);
     friend BigIntBinary operator-(const BigIntBinary& a, const BigIntBinary& b);
+    friend BigIntBinary operator-(BigIntBinary&& a, const BigIntBinary& b);
 
     // Phép nhân
     BigIntBinary& operator*=(const BigIntBinary& other);
     friend BigIntBinary operator*(const BigIntBinary& a, const BigIntBinary& b);
+    BigIntBinary& square(); // *this = *this * *this, mỗi tích chéo chỉ tính một lần
+    // Ghi kết quả vào out, dùng lại vùng nhớ sẵn có của out
+    static void multiply_into(const BigIntBinary& a, const BigIntBinary& b, BigIntBinary& out);
+    static void square_into(const BigIntBinary& a, BigIntBinary& out);
 
     // Phép chia & Modulo 
     void divide(const BigIntBinary& divisor, BigIntBinary& quotient, BigIntBinary& remainder) const;
     BigIntBinary& operator/=(const BigIntBinary& other);
     friend BigIntBinary operator/(const BigIntBinary& a, const BigIntBinary& b);
+    friend BigIntBinary operator/(BigIntBinary&& a, const BigIntBinary& b);
     BigIntBinary& operator%=(const BigIntBinary& other);
     friend BigIntBinary operator%(const BigIntBinary& a, const BigIntBinary& b);
+    friend BigIntBinary operator%(BigIntBinary&& a, const BigIntBinary& b);
 
     // --- Phép so sánh ---
     friend bool operator<(const BigIntBinary& a, const BigIntBinary& b);
@@ -74,10 +367,319 @@ public:
     friend bool operator<=(const BigIntBinary& a, const BigIntBinary& b);
     friend bool operator>=(const BigIntBinary& a, const BigIntBinary& b);
 
+    friend class MontgomeryContext;
+    friend class BarrettContext;
+    friend class FixedBaseExp;
+    friend void tune_multiplication_thresholds();
+    friend BigIntBinary mod_inverse_ct(const BigIntBinary& a, const BigIntBinary& m);
+};
+
+// --- Ngữ cảnh Montgomery ---
+// Dựng một lần cho mỗi modulo n lẻ, giữ các số ở dạng Montgomery (a * R mod n, R = 2^(LIMB_BITS * k))
+// và rút gọn bằng REDC theo từng limb, không cần phép chia trong vòng lặp lũy thừa.
+class MontgomeryContext {
+private:
+    BigIntBinary n;
+    size_t k;            // Số limb của n
+    limb_t n0_inv;       // -n^(-1) mod 2^LIMB_BITS
+    BigIntBinary r2;     // R^2 mod n
+    BigIntBinary one;    // R mod n (số 1 ở dạng Montgomery)
+
+    // Kernel nhân + REDC gộp (CIOS) với số limb cố định lúc biên dịch, cho các nhóm DH chuẩn
+    // (bình phương vẫn dùng kernel bình phương riêng vì ít phép nhân limb hơn)
+    typedef void (*FixedMulKernel)(limb_t* r, const limb_t* a, const limb_t* b, const limb_t* n, limb_t n0_inv);
+    FixedMulKernel mul_fixed;
+    FixedMulKernel mul_ct_fixed; // Cùng kernel, dùng cho mọi k chuẩn trong chế độ thời gian hằng
+    template <size_t K>
+    static void mont_mul_fixed(limb_t* r, const limb_t* a, const limb_t* b, const limb_t* n, limb_t n0_inv);
+    // CIOS trên đúng k limb, không rẽ nhánh theo dữ liệu (kể cả bước trừ n cuối); t: vùng tạm k + 2 limb
+    static void mont_mul_ct(limb_t* r, const limb_t* a, const limb_t* b, const limb_t* n, limb_t n0_inv,
+                            size_t k, limb_t* t);
+    // Bình phương schoolbook + REDC từng limb, thời gian hằng; t: vùng tạm 2k limb
+    static void mont_sqr_ct(limb_t* r, const limb_t* a, const limb_t* n, limb_t n0_inv, size_t k, limb_t* t);
+    // r = t - n nếu (top, t) >= n, ngược lại r = t; chọn bằng mặt nạ
+    static void ct_reduce_once(limb_t* r, const limb_t* t, limb_t top, const limb_t* n, size_t k);
+    void mul_ct(limb_t* r, const limb_t* a, const limb_t* b, limb_t* t) const;
+
+    void redc(BigIntBinary& t) const;
+    void select_kernel();
+
+    // Dựng lại từ các hằng số đã tính sẵn (bảng nhóm trong file), không cần phép chia
+    MontgomeryContext(const BigIntBinary& modulus, limb_t n0_inv, const BigIntBinary& r2, const BigIntBinary& one);
+
+public:
+    MontgomeryContext(const BigIntBinary& modulus);
+
+    const BigIntBinary& modulus() const { return n; }
+    const BigIntBinary& mont_one() const { return one; }
+    size_t size() const { return k; }
+
+    BigIntBinary to_mont(const BigIntBinary& a) const;
+    BigIntBinary from_mont(const BigIntBinary& a) const;
+    BigIntBinary mul(const BigIntBinary& a, const BigIntBinary& b) const; // a * b * R^(-1) mod n
+    BigIntBinary sqr(const BigIntBinary& a) const; // a * a * R^(-1) mod n
+    void mul(const BigIntBinary& a, const BigIntBinary& b, BigIntBinary& out) const; // Ghi vào out, không cấp phát
+    void sqr(const BigIntBinary& a, BigIntBinary& out) const;
+    void mul(const BigIntBinary& a, const limb_t* b, BigIntBinary& out) const; // b: đúng k limb thô, bù 0 ở đầu cao
+    BigIntBinary pow(const BigIntBinary& a, const BigIntBinary& e) const; // a^e mod n (kết quả ở dạng thường)
+    BigIntBinary pow_base2(const BigIntBinary& e) const; // 2^e mod n, nhân với 2 bằng dịch bit
+    // a^e mod n thời gian hằng cho số mũ bí mật: cửa sổ cố định, tra bảng bằng mặt nạ, mọi phép tính
+    // trên mảng đúng k limb không chuẩn hóa. Thời gian chỉ phụ thuộc k và exp_bits, không phụ thuộc e.
+    // exp_bits: giới hạn công khai của độ dài e (ví dụ SHORT_EXPONENT_BITS), 0 = số bit của n;
+    // e dài hơn giới hạn thì ném std::invalid_argument
+    BigIntBinary pow_ct(const BigIntBinary& a, const BigIntBinary& e, int exp_bits = 0) const;
+    // a_1^e_1 * ... * a_m^e_m mod n với một chuỗi bình phương chung (Straus)
+    BigIntBinary multi_pow(const std::vector<BigIntBinary>& bases, const std::vector<BigIntBinary>& exponents) const;
+
+    friend class FixedBaseExp;
+};
+
+// --- Ngữ cảnh Barrett ---
+// Rút gọn theo modulo n cố định mà không cần đổi sang dạng Montgomery: tính sẵn mu = floor(BASE^(2k) / n),
+// sau đó mỗi lần rút gọn x < BASE^(2k) chỉ cần hai phép nhân và vài phép trừ thay cho phép chia.
+class BarrettContext {
+private:
+    BigIntBinary n;
+    size_t k;          // Số limb của n
+    BigIntBinary mu;   // floor(BASE^(2k) / n)
+
+public:
+    explicit BarrettContext(const BigIntBinary& modulus);
+
+    const BigIntBinary& modulus() const { return n; }
+
+    void reduce(BigIntBinary& x) const; // x = x mod n (x dài hơn 2k limb thì quay về phép chia)
+    void mul(const BigIntBinary& a, const BigIntBinary& b, BigIntBinary& out) const; // a * b mod n
+    void sqr(const BigIntBinary& a, BigIntBinary& out) const;                        // a * a mod n
+};
+
+BigIntBinary operator%(const BigIntBinary& x, const BarrettContext& ctx);
+BigIntBinary operator%(BigIntBinary&& x, const BarrettContext& ctx);
+BigIntBinary& operator%=(BigIntBinary& x, const BarrettContext& ctx);
+
+// --- File bảng nhóm ---
+// Bố cục: GroupTableHeader rồi các mảng đúng k limb: p, R^2 mod p, R mod p, g, và các mục của
+// bảng lũy thừa cơ số cố định (dạng Montgomery). Số nguyên và limb theo thứ tự byte của máy ghi.
+// File được ánh xạ chỉ đọc bằng mmap/MapViewOfFile, dùng trực tiếp không phân tích hay sao chép.
+struct GroupTableHeader {
+    char magic[8];        // "BIGDHGT1"
+    uint32_t version;
+    uint32_t limb_bits;   // Phải trùng LIMB_BITS của máy đọc
+    uint32_t byte_order;  // 0x01020304 theo thứ tự byte của máy ghi
+    uint32_t window;
+    uint32_t max_bits;
+    uint32_t reserved;
+    uint64_t k;           // Số limb của p
+    uint64_t n0_inv;      // -p^(-1) mod 2^LIMB_BITS
+    uint64_t entries;     // Số mục của bảng lũy thừa
+};
+
+class GroupTableFile {
+private:
+    const unsigned char* base;
+    size_t length;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+
+    void unmap();
+    const limb_t* section(size_t i) const {
+        return reinterpret_cast<const limb_t*>(base + sizeof(GroupTableHeader)) + i * header().k;
+    }
+
+public:
+    explicit GroupTableFile(const std::string& path);
+    ~GroupTableFile();
+    GroupTableFile(const GroupTableFile&) = delete;
+    GroupTableFile& operator=(const GroupTableFile&) = delete;
+
+    const GroupTableHeader& header() const { return *reinterpret_cast<const GroupTableHeader*>(base); }
+    const limb_t* modulus() const { return section(0); }
+    const limb_t* r2() const { return section(1); }
+    const limb_t* one() const { return section(2); }
+    const limb_t* generator() const { return section(3); }
+    const limb_t* table() const { return section(4); }
+};
+
+// --- Lũy thừa với cơ số cố định ---
+// Dựng một lần cho mỗi cặp (g, p): table[i][d] = g^(d * 2^(w*i)) ở dạng Montgomery.
+// Khi đó g^x = tích các table[i][x_i] với x_i là các nhóm w bit của x, không cần bình phương.
+// Mỗi mục là đúng k limb liền nhau, nên bảng có thể nằm ngay trong file bảng nhóm đã ánh xạ.
+class FixedBaseExp {
+private:
+    MontgomeryContext ctx;
+    BigIntBinary g;
+    int w;                         // Độ rộng một nhóm bit của số mũ
+    int max_bits;                  // Số mũ dài hơn thì quay về ctx.pow
+    std::vector<limb_t> storage;   // Bảng tự dựng; trống khi dùng bảng trong file
+    const limb_t* mapped;          // Bảng trong file đã ánh xạ (file phải sống lâu hơn đối tượng này)
+
+    size_t entry_count() const;
+    static BigIntBinary from_limbs(const limb_t* data, size_t k); // Số nguyên từ k limb thô trong file
+    // Mục table[i * (2^w - 1) + d - 1], d = 1..2^w-1
+    const limb_t* entry(size_t index) const { return (mapped ? mapped : storage.data()) + index * ctx.size(); }
+
+public:
+    FixedBaseExp(const BigIntBinary& base, const BigIntBinary& p, int window = 4, int max_exp_bits = 0);
+    explicit FixedBaseExp(const GroupTableFile& file);
+
+    const MontgomeryContext& context() const { return ctx; }
+    const BigIntBinary& modulus() const { return ctx.modulus(); }
+    BigIntBinary pow(const BigIntBinary& e) const; // g^e mod p
+    BigIntBinary pow_ct(const BigIntBinary& e, int exp_bits = 0) const; // g^e mod p thời gian hằng, exp_bits như MontgomeryContext::pow_ct
+    void save(const std::string& path) const;      // Ghi file bảng nhóm cho GroupTableFile
+};
+
+// --- Thread pool chia việc kiểu work-stealing ---
+// Mỗi luồng nhận một đoạn chỉ số liên tiếp; làm hết phần mình thì lấy một nửa phần còn lại
+// của luồng khác. Luồng gọi parallel_for cũng tham gia làm việc. Các luồng sống suốt đời pool
+// nên vùng nhớ tạm thread_local của phép nhân được dùng lại qua các lô.
+// Mỗi lúc chỉ một luồng được gọi parallel_for.
+class WorkStealingPool {
+private:
+    struct Range {
+        std::mutex m;
+        size_t begin = 0, end = 0;
+    };
+
+    unsigned count;                          // Số luồng, kể cả luồng gọi
+    std::vector<std::thread> threads;
+    std::unique_ptr<Range[]> ranges;
+    std::mutex m;
+    std::condition_variable cv_start, cv_done;
+    const std::function<void(size_t)>* job;
+    size_t generation;                       // Tăng mỗi lô để đánh thức các luồng
+    unsigned pending;                        // Số luồng phụ chưa xong lô hiện tại
+    bool shutdown;
+    std::exception_ptr error;                // Ngoại lệ đầu tiên trong lô, ném lại ở luồng gọi
+
+    void worker_loop(unsigned id);
+    void run(unsigned id);
+    bool take(unsigned id, size_t& index);
+    bool steal(unsigned id, size_t& index);
+
+public:
+    explicit WorkStealingPool(unsigned num_threads = 0); // 0 = số lõi của máy
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return count; }
+    void parallel_for(size_t n, const std::function<void(size_t)>& f); // f(i) với i = 0..n-1, chờ xong
+};
+
+// --- Xử lý Diffie-Hellman theo lô ---
+// Dùng chung một nhóm (p, g): bảng lũy thừa của g và ngữ cảnh Montgomery của p dựng một lần,
+// chỉ đọc nên các luồng dùng chung không cần khóa.
+class DHBatchEngine {
+private:
+    FixedBaseExp generator;
+    WorkStealingPool pool;
+    bool constant_time;   // Dùng pow_ct cho mọi phép tính với khóa riêng (mặc định bật)
+    int exponent_bits;    // Giới hạn độ dài khóa riêng cho pow_ct, 0 = độ dài p
+    bool validate_peers;  // Kiểm tra khóa công khai của đối phương bằng validate_public_key (mặc định bật)
+
+public:
+    DHBatchEngine(const BigIntBinary& p, const BigIntBinary& g, unsigned num_threads = 0);
+    explicit DHBatchEngine(const GroupTableFile& file, unsigned num_threads = 0);
+
+    unsigned num_threads() const { return pool.size(); }
+    const MontgomeryContext& context() const { return generator.context(); }
+    void set_constant_time(bool enabled) { constant_time = enabled; }
+    void set_exponent_bits(int bits) { exponent_bits = bits; } // SHORT_EXPONENT_BITS khi dùng khóa riêng ngắn
+    void set_validate_peers(bool enabled) { validate_peers = enabled; } // Chỉ dùng khi p là số nguyên tố an toàn
+
+    // g^x_i mod p
+    std::vector<BigIntBinary> public_keys(const std::vector<BigIntBinary>& private_keys);
+    // y_i^x_i mod p (từng cặp khóa công khai của đối phương và khóa riêng); khóa không hợp lệ thì ném lỗi
+    std::vector<BigIntBinary> shared_secrets(const std::vector<BigIntBinary>& peer_public_keys,
+                                             const std::vector<BigIntBinary>& private_keys);
+    // y_i^x mod p (một khóa riêng với nhiều đối phương)
+    std::vector<BigIntBinary> shared_secrets(const std::vector<BigIntBinary>& peer_public_keys,
+                                             const BigIntBinary& private_key);
 };
 
 BigIntBinary modular_exponentiation(BigIntBinary a, BigIntBinary b, BigIntBinary n); // a^b % n
-BigIntBinary generate_private_key(const BigIntBinary& p);
-BigIntBinary generate_safe_prime(int bit_size);
+BigIntBinary modular_exponentiation_ct(const BigIntBinary& a, const BigIntBinary& b, const BigIntBinary& n,
+                                       int exp_bits = 0); // n lẻ, b bí mật, exp_bits như MontgomeryContext::pow_ct
+BigIntBinary multi_exponentiation(const std::vector<BigIntBinary>& bases, const std::vector<BigIntBinary>& exponents,
+                                  const BigIntBinary& n); // a_1^e_1 * ... * a_m^e_m % n
+int exponent_window_size(int bits);
+
+// --- Ước chung lớn nhất và nghịch đảo modulo ---
+// Lehmer: mỗi vòng chạy Euclid trên 60 bit đầu của hai số bằng số nguyên máy, rồi áp ma trận hệ số
+// tích lũy lên số lớn một lần (khoảng 30 bit mỗi vòng); chỉ chia số lớn khi thương đầu tiên quá lớn.
+// BigIntBinary không có dấu nên dấu của hệ số Bézout lưu riêng: (-1)^x_negative * x * a + (-1)^y_negative * y * b = g
+struct ExtendedGcd {
+    BigIntBinary g;
+    BigIntBinary x, y;
+    bool x_negative, y_negative;
+};
+
+BigIntBinary gcd(const BigIntBinary& a, const BigIntBinary& b);
+ExtendedGcd extended_gcd(const BigIntBinary& a, const BigIntBinary& b);
+BigIntBinary mod_inverse(const BigIntBinary& a, const BigIntBinary& m); // a^(-1) mod m trong [0, m), ném lỗi khi gcd(a, m) != 1
+// Cho a bí mật, m lẻ: đúng 2 * (số bit của k limb) bước Euclid nhị phân trên mảng k limb, chọn bằng mặt nạ.
+// Thời gian chỉ phụ thuộc số limb của m (a >= m được rút gọn trước bằng phép chia thường).
+BigIntBinary mod_inverse_ct(const BigIntBinary& a, const BigIntBinary& m);
+
+// --- Kiểm tra khóa công khai ---
+int jacobi_symbol(const BigIntBinary& a, const BigIntBinary& n); // (a/n) với n lẻ: 1, -1 hoặc 0
+// p = 2q + 1 an toàn: nhóm con bậc q đúng bằng tập các thặng dư bậc hai, nên 1 < y < p - 1 và (y/p) = 1
+// là đủ, thay cho y^q mod p == 1 mà không cần phép lũy thừa. g = 2 thuộc nhóm con này vì p ≡ 7 (mod 8).
+bool validate_public_key(const BigIntBinary& y, const BigIntBinary& p);
+// Cả lô khóa thuộc nhóm con bậc q nguyên tố lẻ (q | p - 1): kiểm tra khoảng và Jacobi từng khóa, rồi với
+// r_i ngẫu nhiên security_bits bit kiểm tra (prod y_i^r_i)^q mod p == 1: một multi_exponentiation với số mũ
+// ngắn và một phép lũy thừa cho cả lô. Khóa ngoài nhóm con lọt qua với xác suất không quá 1/l hoặc
+// 2^-security_bits, l là ước nguyên tố nhỏ nhất của (p - 1) / q. p = 2q + 1 thì chỉ cần Jacobi.
+bool validate_public_keys(const std::vector<BigIntBinary>& keys, const BigIntBinary& p, const BigIntBinary& q,
+                          int security_bits = 64);
+
+// --- Nguồn số ngẫu nhiên ---
+// Mọi khóa riêng, cơ sở Miller-Rabin và ứng viên nguyên tố đều lấy byte từ random_source().
+// fill() có thể được gọi đồng thời từ nhiều luồng.
+class RandomSource {
+public:
+    virtual ~RandomSource() {}
+    virtual void fill(uint8_t* out, size_t len) = 0;
+};
+
+// Nguồn mặc định: ChaCha20 DRBG riêng cho mỗi luồng, seed 32 byte từ hệ điều hành (getrandom / BCryptGenRandom).
+// Sinh trước RANDOM_BUFFER_BYTES byte mỗi lần nên các luồng không tranh khóa và không gọi hệ thống cho từng khóa;
+// 32 byte đầu của mỗi lô thay khóa ChaCha (xóa khóa cũ), seed lại sau RANDOM_RESEED_BYTES byte hoặc sau fork().
+class ChaCha20Random : public RandomSource {
+public:
+    void fill(uint8_t* out, size_t len) override;
+};
+
+// Đọc thẳng từ hệ điều hành ở mỗi lần gọi (chậm hơn, không giữ trạng thái trong tiến trình)
+class SystemRandom : public RandomSource {
+public:
+    void fill(uint8_t* out, size_t len) override;
+};
+
+const size_t RANDOM_BUFFER_BYTES = 8192;
+const uint64_t RANDOM_RESEED_BYTES = (uint64_t)1 << 26;
+
+void os_random_bytes(uint8_t* out, size_t len);
+RandomSource& random_source();
+void set_random_source(RandomSource* source); // nullptr = ChaCha20Random mặc định; source phải sống đến khi đổi lại
+
+// Khóa riêng ngắn cho nhóm từ 2048 bit: 256 bit là gấp đôi mức bảo mật 128 bit, mọi phép lũy thừa sau đó ngắn đi ~8 lần
+const int SHORT_EXPONENT_BITS = 256;
+BigIntBinary generate_private_key(const BigIntBinary& p, int exponent_bits = 0); // [2, p - 2], hoặc [2, 2^exponent_bits)
+// p = 2q + 1 với p ≡ 23 (mod 24) để g = 2 sinh nhóm con cấp q; bit_size >= 8, num_threads = 0 là số lõi của máy
+BigIntBinary generate_safe_prime(int bit_size, unsigned num_threads = 0);
+bool is_probable_prime(const BigIntBinary& n, int rounds);
+void tune_multiplication_thresholds();
+MulKernel detect_mul_kernel();             // Kernel tốt nhất mà CPU hỗ trợ (mặc định khi khởi động)
+bool mul_kernel_supported(MulKernel kernel);
+MulKernel active_mul_kernel();
+void set_mul_kernel(MulKernel kernel);     // Gọi trước khi tạo luồng
+const char* mul_kernel_name(MulKernel kernel);
+bool check_mul_kernels(size_t rounds);     // So sánh từng kernel SIMD với bản vô hướng trên số ngẫu nhiên
+bool check_group_table_file(const std::string& path); // Ghi file bảng nhóm thử tại path, kiểm tra file hỏng bị từ chối
+void benchmark_dh_throughput(int bit_size, size_t handshakes, unsigned max_threads);
 
 #endif